@@ -0,0 +1,225 @@
+#include "action.h"
+#include "uinput.h"
+#include "macro.h"
+#include "plugin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <X11/Xlib.h>
+
+// xdotool modifier aliases
+static const struct {
+    const char* alias;
+    const char* keysym;
+} ALIASES[] = {
+    {"ctrl", "Control_L"},
+    {"control", "Control_L"},
+    {"shift", "Shift_L"},
+    {"alt", "Alt_L"},
+    {"super", "Super_L"},
+    {"meta", "Meta_L"},
+};
+
+static void resolve_key(const char* name, action_key_t* key) {
+    const char* keysym_name = name;
+
+    for (size_t i = 0; i < sizeof(ALIASES) / sizeof(ALIASES[0]); i++) {
+        if (strcasecmp(name, ALIASES[i].alias) == 0) {
+            keysym_name = ALIASES[i].keysym;
+            break;
+        }
+    }
+    KeySym keysym = XStringToKeysym(keysym_name);
+    key->keysym = keysym != NoSymbol ? (unsigned long)keysym : 0;
+
+    int shift = 0;
+    if (uinput_lookup(name, &key->code, &shift) < 0) {
+        key->code = 0;
+    }
+    key->shift = (unsigned char)shift;
+}
+
+static void add_op(action_t* action, action_op_type_t op, int key) {
+    action->ops[action->tap.length + action->down.length + action->up.length].op = (unsigned char)op;
+    action->ops[action->tap.length + action->down.length + action->up.length].key = (unsigned char)key;
+}
+
+// Split the text into chords and keys and build the three sequences.
+// Text that doesn't fit the limits is left with no keys; the backends
+// then hand it to xdotool as it is.
+static void compile_keys(action_t* action) {
+    int chord_start[ACTION_MAX_CHORDS], chord_size[ACTION_MAX_CHORDS];
+    int chords = 0;
+    const char* p = action->text;
+
+    action->key_count = 0;
+    while (*p) {
+        while (*p == ' ') p++;
+        if (*p == '\0') break;
+
+        size_t chord_len = strcspn(p, " ");
+        const char* end = p + chord_len;
+        if (chords >= ACTION_MAX_CHORDS) goto unusable;
+        chord_start[chords] = action->key_count;
+
+        while (p < end) {
+            const char* plus = memchr(p, '+', end - p);
+            size_t len = plus ? (size_t)(plus - p) : (size_t)(end - p);
+            char name[64];
+
+            // The '+' key itself is spelled "plus", as in xdotool
+            if (len == 0 || len >= sizeof(name) || action->key_count >= ACTION_MAX_KEYS) goto unusable;
+            memcpy(name, p, len);
+            name[len] = '\0';
+            resolve_key(name, &action->keys[action->key_count++]);
+            p = plus ? plus + 1 : end;
+        }
+        chord_size[chords] = action->key_count - chord_start[chords];
+        chords++;
+    }
+    if (chords == 0) goto unusable;
+
+    action->flags = ACTION_HAS_KEYSYMS | ACTION_HAS_CODES;
+    for (int k = 0; k < action->key_count; k++) {
+        if (action->keys[k].keysym == 0) action->flags &= ~ACTION_HAS_KEYSYMS;
+        if (action->keys[k].code == 0) action->flags &= ~ACTION_HAS_CODES;
+    }
+
+    // Full press: each chord pressed and released in turn
+    action->tap.start = 0;
+    for (int c = 0; c < chords; c++) {
+        for (int k = 0; k < chord_size[c]; k++) {
+            add_op(action, ACTION_OP_PRESS, chord_start[c] + k);
+            action->tap.length++;
+        }
+        add_op(action, ACTION_OP_SYNC, 0);
+        action->tap.length++;
+        for (int k = chord_size[c] - 1; k >= 0; k--) {
+            add_op(action, ACTION_OP_RELEASE, chord_start[c] + k);
+            action->tap.length++;
+        }
+        add_op(action, ACTION_OP_SYNC, 0);
+        action->tap.length++;
+    }
+
+    // Key down / key up: presses or releases only
+    action->down.start = action->tap.length;
+    for (int c = 0; c < chords; c++) {
+        for (int k = 0; k < chord_size[c]; k++) {
+            add_op(action, ACTION_OP_PRESS, chord_start[c] + k);
+            action->down.length++;
+        }
+        add_op(action, ACTION_OP_SYNC, 0);
+        action->down.length++;
+    }
+    action->up.start = action->tap.length + action->down.length;
+    for (int c = 0; c < chords; c++) {
+        for (int k = chord_size[c] - 1; k >= 0; k--) {
+            add_op(action, ACTION_OP_RELEASE, chord_start[c] + k);
+            action->up.length++;
+        }
+        add_op(action, ACTION_OP_SYNC, 0);
+        action->up.length++;
+    }
+    return;
+
+unusable:
+    action->key_count = 0;
+    action->flags = 0;
+}
+
+static action_t* compile(const char* text, action_kind_t kind) {
+    action_t* action = calloc(1, sizeof(action_t));
+    if (action == NULL) return NULL;
+
+    action->text = strdup(text);
+    if (action->text == NULL) {
+        free(action);
+        return NULL;
+    }
+    action->kind = kind;
+    if (kind == ACTION_KEYS) {
+        compile_keys(action);
+    }
+    return action;
+}
+
+action_t* action_create(const char* text, int type) {
+    if (text == NULL) return NULL;
+
+    if (strcmp(text, "NULL") == 0) return compile(text, ACTION_NONE);
+    if (strcmp(text, "leader") == 0) return compile(text, ACTION_LEADER);
+    if (strcmp(text, "swap") == 0) return compile(text, ACTION_SWAP);
+    if (strncmp(text, "mouse", 5) == 0 && text[5] >= '1' && text[5] <= '5' && text[6] == '\0') {
+        action_t* action = compile(text, ACTION_MOUSE);
+        if (action) action->mouse_button = text[5] - '0';
+        return action;
+    }
+    if (strncmp(text, "plugin:", 7) == 0) {
+        action_t* action = compile(text, ACTION_PLUGIN);
+        plugin_resolve(action);
+        return action;
+    }
+    if (type == 3) {
+        // A macro that doesn't parse does nothing
+        macro_t* macro = macro_create(text);
+        action_t* action = compile(text, macro ? ACTION_MACRO : ACTION_NONE);
+        if (action) action->macro = macro;
+        else macro_destroy(macro);
+        return action;
+    }
+    return compile(text, type == 1 ? ACTION_PROGRAM : ACTION_KEYS);
+}
+
+void action_destroy(action_t* action) {
+    if (action == NULL) return;
+    action_destroy(action->leader);
+    macro_destroy(action->macro);
+    free(action->text);
+    free(action);
+}
+
+action_t* action_copy(const action_t* action) {
+    if (action == NULL) return NULL;
+
+    action_t* copy = malloc(sizeof(action_t));
+    if (copy == NULL) return NULL;
+    *copy = *action;
+    copy->leader = NULL;
+    copy->macro = NULL;
+    copy->text = strdup(action->text);
+    if (copy->text == NULL) {
+        free(copy);
+        return NULL;
+    }
+    if (action->plugin_action) copy->plugin_action = copy->text + (action->plugin_action - action->text);
+    return copy;
+}
+
+void action_set_leader(action_t* action, const char* leader_function) {
+    if (action == NULL) return;
+
+    action_destroy(action->leader);
+    action->leader = NULL;
+    if (action->kind == ACTION_LEADER || action->kind == ACTION_MACRO ||
+        action->kind == ACTION_PLUGIN) return;
+
+    if (leader_function == NULL || leader_function[0] == '\0') {
+        action->leader = compile(action->text, ACTION_KEYS);
+        return;
+    }
+
+    size_t len = strlen(leader_function) + strlen(action->text) + 2;
+    char* combination = malloc(len);
+    if (combination == NULL) return;
+    snprintf(combination, len, "%s+%s", leader_function, action->text);
+    action->leader = compile(combination, ACTION_KEYS);
+    free(combination);
+}
+
+const action_op_t* action_sequence(const action_t* action, int type, int* count) {
+    const action_seq_t* seq = type == 0 ? &action->down : type == 1 ? &action->up : &action->tap;
+    *count = seq->length;
+    return action->ops + seq->start;
+}
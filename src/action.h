@@ -0,0 +1,107 @@
+#ifndef ACTION_H
+#define ACTION_H
+
+#include "kd100_plugin.h"
+
+// ============================================================================
+// COMPILED ACTIONS
+// ============================================================================
+//
+// Every function:, wheel left:/right: and leader combination string is
+// compiled once, when the configuration is loaded, into an action program:
+// its kind, the keys it names (X keysym and Linux key code) and the
+// press/release sequences for a full press, a key down and a key up.
+// Injection backends play these programs directly, so a button press never
+// parses, concatenates or allocates strings.
+//
+// Key strings use the xdotool syntax: keysym names joined by '+' form a
+// chord ("ctrl+shift+z"), chords separated by spaces are sent in turn
+// ("ctrl+c ctrl+v"). xdotool's modifier aliases (ctrl, shift, alt, super,
+// meta) are understood. The source text is kept for the OSD, debug output
+// and the xdotool backends.
+//
+// ============================================================================
+
+#define ACTION_MAX_KEYS   16   // Keys over all chords of one action
+#define ACTION_MAX_CHORDS 8
+#define ACTION_MAX_OPS    (ACTION_MAX_KEYS * 4 + ACTION_MAX_CHORDS * 4)
+
+// What a button or wheel function does
+typedef enum {
+    ACTION_NONE,      // "NULL": nothing (releases a held mouse button)
+    ACTION_KEYS,      // Key sequence
+    ACTION_PROGRAM,   // Run a program/script (button type 1)
+    ACTION_MOUSE,     // mouse1-mouse5
+    ACTION_LEADER,    // This button is the leader key
+    ACTION_SWAP,      // Cycle the wheel function
+    ACTION_MACRO,     // Play a macro (button type 3, see macro.h)
+    ACTION_PLUGIN     // "plugin:<name>.<action>" (see kd100_plugin.h)
+} action_kind_t;
+
+// Backends the keys could all be resolved for
+#define ACTION_HAS_KEYSYMS 0x1   // XTest
+#define ACTION_HAS_CODES   0x2   // uinput
+
+// One key of an action
+typedef struct {
+    unsigned long keysym;        // X keysym (0 = unknown)
+    unsigned short code;         // Linux key code (0 = not in the uinput keymap)
+    unsigned char shift;         // Code is on the shifted level (uinput)
+} action_key_t;
+
+// Program operations
+typedef enum {
+    ACTION_OP_PRESS,
+    ACTION_OP_RELEASE,
+    ACTION_OP_SYNC               // End of a press or release group
+} action_op_type_t;
+
+typedef struct {
+    unsigned char op;            // action_op_type_t
+    unsigned char key;           // Index into keys[]
+} action_op_t;
+
+// Slice of ops[]
+typedef struct {
+    unsigned char start;
+    unsigned char length;
+} action_seq_t;
+
+typedef struct action action_t;
+typedef struct macro macro_t;
+
+struct action {
+    action_kind_t kind;
+    char* text;                  // Source string
+    int mouse_button;            // ACTION_MOUSE: 1-5
+    macro_t* macro;              // ACTION_MACRO: compiled steps
+    const kd100_plugin_t* plugin;    // ACTION_PLUGIN: plugin of <name> (NULL = not loaded)
+    const char* plugin_action;   // ACTION_PLUGIN: <action> (points into text)
+    int flags;                   // ACTION_HAS_*
+
+    int key_count;
+    action_key_t keys[ACTION_MAX_KEYS];
+    action_op_t ops[ACTION_MAX_OPS];
+    action_seq_t tap;            // Full press of every chord in turn
+    action_seq_t down;           // Key down
+    action_seq_t up;             // Key up
+
+    action_t* leader;            // leader_function+text as keys (NULL = none)
+};
+
+// Compile a function string. type is the button type (1 = program,
+// 3 = macro); NULL text gives NULL.
+action_t* action_create(const char* text, int type);
+void action_destroy(action_t* action);
+
+// Copy of the keys of an action (no leader combination or macro)
+action_t* action_copy(const action_t* action);
+
+// Compile the leader combination of this action (leader_function may be
+// NULL or empty: the function alone is sent as keys)
+void action_set_leader(action_t* action, const char* leader_function);
+
+// Ops of a full press (-1), key down (0) or key up (1)
+const action_op_t* action_sequence(const action_t* action, int type, int* count);
+
+#endif // ACTION_H
@@ -0,0 +1,274 @@
+#include "capture.h"
+#include "dispatch.h"
+#include "handler.h"
+#include "reactor.h"
+#include "latency.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+capture_t* capture_open(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Unable to open capture file %s\n", path);
+        return NULL;
+    }
+
+    capture_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    header.record_size = sizeof(capture_record_t);
+
+    capture_t* capture = calloc(1, sizeof(capture_t));
+    if (capture == NULL || fwrite(&header, sizeof(header), 1, file) != 1) {
+        printf("Unable to write capture file %s\n", path);
+        free(capture);
+        fclose(file);
+        return NULL;
+    }
+
+    capture->file = file;
+    printf("Capturing reports to %s\n", path);
+    return capture;
+}
+
+void capture_close(capture_t* capture) {
+    if (capture == NULL) return;
+
+    fclose(capture->file);
+    printf("Captured %ld reports\n", capture->records);
+    free(capture);
+}
+
+void capture_write(capture_t* capture, int keypad, const unsigned char* data, int length) {
+    capture_record_t record;
+
+    if (length > CAPTURE_REPORT_SIZE) length = CAPTURE_REPORT_SIZE;
+
+    memset(&record, 0, sizeof(record));
+    record.timestamp_ns = get_time_ns();
+    record.keypad = (uint8_t)keypad;
+    record.length = (uint8_t)length;
+    memcpy(record.data, data, length);
+
+    // Stdio buffering keeps this off the syscall path; flushed on close
+    if (fwrite(&record, sizeof(record), 1, capture->file) == 1) {
+        capture->records++;
+    }
+}
+
+// Record carrying a name (profile, port or file) instead of a report
+static void write_name(capture_t* capture, int kind, int keypad, const char* name) {
+    capture_record_t record;
+    int length = (int)strlen(name);
+
+    if (length > CAPTURE_REPORT_SIZE) length = CAPTURE_REPORT_SIZE;
+
+    memset(&record, 0, sizeof(record));
+    record.timestamp_ns = get_time_ns();
+    record.keypad = (uint8_t)keypad;
+    record.length = (uint8_t)length;
+    record.kind = (uint8_t)kind;
+    memcpy(record.data, name, length);
+
+    if (fwrite(&record, sizeof(record), 1, capture->file) == 1) {
+        capture->records++;
+    }
+}
+
+void capture_write_profile(capture_t* capture, const char* name) {
+    write_name(capture, CAPTURE_RECORD_PROFILE, 0, name);
+}
+
+void capture_write_attach(capture_t* capture, int keypad, const char* port) {
+    write_name(capture, CAPTURE_RECORD_ATTACH, keypad, port);
+}
+
+void capture_write_reload(capture_t* capture, const char* filename) {
+    write_name(capture, CAPTURE_RECORD_RELOAD, 0, filename);
+}
+
+// Run the reactor (leader / click timers) until the deadline
+static void replay_wait_until(reactor_t* reactor, uint64_t deadline_ns) {
+    for (;;) {
+        uint64_t now = get_time_ns();
+        if (now >= deadline_ns) break;
+        long remaining_ms = (long)((deadline_ns - now + 999999) / 1000000);
+        if (reactor_run_once(reactor, (int)remaining_ms) < 0) break;
+    }
+}
+
+// Fast replay: step the virtual clock to target_ms, running the timers due
+// on the way at their own deadlines. A timer armed for the current tick
+// fires one tick later, as it would on the real clock.
+static void replay_advance(reactor_t* reactor, long target_ms) {
+    for (;;) {
+        long wait = reactor_timer_wait(reactor, 0);
+        long next = get_time_ms() + (wait > 0 ? wait : 1);
+        if (wait < 0 || next > target_ms) break;
+        set_virtual_time_ms(next);
+        reactor_run_once(reactor, 0);
+    }
+    if (target_ms > get_time_ms()) {
+        set_virtual_time_ms(target_ms);
+    }
+}
+
+// End of the capture: let every one-shot timer (click, leader, chord and
+// tap-hold windows, key releases) run out. Autorepeat would never stop.
+static void replay_drain(reactor_t* reactor, int fast) {
+    long wait;
+    while ((wait = reactor_timer_wait(reactor, 1)) >= 0) {
+        if (wait == 0) wait = 1;
+        if (fast) {
+            replay_advance(reactor, get_time_ms() + wait);
+        } else {
+            replay_wait_until(reactor, get_time_ns() + (uint64_t)wait * 1000000ull);
+        }
+    }
+}
+
+// Name a profile switch, attach or reload record carries
+static void record_name(const capture_record_t* record, char* name) {
+    memcpy(name, record->data, record->length);
+    name[record->length] = '\0';
+}
+
+// Switch to the profile a profile switch record names
+static void replay_profile(profile_manager_t* profile_manager, const capture_record_t* record,
+                           int debug) {
+    char name[CAPTURE_REPORT_SIZE + 1];
+
+    record_name(record, name);
+    if (profile_manager == NULL || profile_manager_switch(profile_manager, name) < 0) {
+        printf("Replay: profile '%s' not loaded, switch ignored\n", name);
+    } else if (debug) {
+        printf("Replay: switched to profile '%s'\n", name);
+    }
+}
+
+// Reload the profile file a reload record names
+static void replay_reload(profile_manager_t* profile_manager, const capture_record_t* record) {
+    char name[CAPTURE_REPORT_SIZE + 1];
+
+    record_name(record, name);
+    if (profile_manager == NULL || profile_manager->profiles_dir[0] == '\0') {
+        printf("Replay: no profiles directory, reload of %s ignored\n", name);
+        return;
+    }
+    profile_manager_reload_file(profile_manager, name);
+}
+
+int capture_replay(const char* path, config_t* config, profile_manager_t* profile_manager,
+                   int debug, int fast) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Unable to open capture file %s\n", path);
+        return -1;
+    }
+
+    capture_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CAPTURE_VERSION || header.record_size != sizeof(capture_record_t)) {
+        printf("%s is not a KD100 capture file\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    // Fast replay runs deadlines on recorded time, from here on. The
+    // reactor's timer wheel starts on that clock.
+    long base_ms = get_time_ms();
+    if (fast) {
+        set_virtual_time_ms(base_ms);
+    }
+
+    reactor_t* reactor = reactor_create();
+    dispatcher_t* dispatcher = reactor ? dispatcher_create(config, NULL, profile_manager, reactor, debug, 0) : NULL;
+    if (dispatcher == NULL) {
+        printf("Unable to create dispatcher\n");
+        reactor_destroy(reactor);
+        set_virtual_time_ms(-1);
+        fclose(file);
+        return -1;
+    }
+
+    handler_attach_reactor(reactor);
+
+    // Keypads are attached by their attach record, or else as their slot
+    // first appears in the capture
+    keypad_t* keypads[256] = {NULL};
+    capture_record_t record;
+    long reports = 0;
+    long events = 0;              // Attach, profile switch and reload records
+    uint64_t first_ns = 0;
+    uint64_t start_ns = get_time_ns();
+
+    printf("Replaying %s (%s)\n", path, fast ? "as fast as possible" : "recorded timing");
+
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.length > CAPTURE_REPORT_SIZE) continue;
+
+        if (reports == 0 && events == 0) {
+            first_ns = record.timestamp_ns;
+        }
+        uint64_t offset_ns = record.timestamp_ns > first_ns ? record.timestamp_ns - first_ns : 0;
+        if (fast) {
+            replay_advance(reactor, base_ms + (long)(offset_ns / 1000000));
+        } else {
+            replay_wait_until(reactor, start_ns + offset_ns);
+        }
+
+        switch (record.kind) {
+            case CAPTURE_RECORD_REPORT:
+                if (keypads[record.keypad] == NULL) {
+                    keypads[record.keypad] = dispatcher_attach(dispatcher, NULL);
+                    if (keypads[record.keypad] == NULL) continue;
+                }
+                dispatcher_report(record.data, record.length, keypads[record.keypad]);
+                reports++;
+                continue;
+            case CAPTURE_RECORD_PROFILE:
+                replay_profile(profile_manager, &record, debug);
+                break;
+            case CAPTURE_RECORD_ATTACH:
+                if (keypads[record.keypad] == NULL) {
+                    char port[CAPTURE_REPORT_SIZE + 1];
+                    record_name(&record, port);
+                    keypads[record.keypad] = dispatcher_attach(dispatcher, port);
+                }
+                break;
+            case CAPTURE_RECORD_RELOAD:
+                replay_reload(profile_manager, &record);
+                break;
+            default:
+                continue;
+        }
+        events++;
+    }
+
+    uint64_t elapsed_ns = get_time_ns() - start_ns;
+
+    // Let the capture's pending timers run out; detaching the keypads then
+    // sends what is still held back and releases what is held down
+    replay_drain(reactor, fast);
+    dispatcher_destroy(dispatcher);
+    handler_attach_reactor(NULL);
+    set_virtual_time_ms(-1);
+
+    printf("Replayed %ld reports in %.3f ms", reports, elapsed_ns / 1e6);
+    if (reports > 0) {
+        printf(" (%.1f ns/report, %.0f reports/s)",
+               (double)elapsed_ns / reports, reports * 1e9 / (elapsed_ns ? elapsed_ns : 1));
+    }
+    printf("\n");
+    if (handler_get_sink() == HANDLER_SINK_COUNT) {
+        printf("Actions dispatched: %ld\n", handler_get_count());
+    }
+    latency_dump();
+
+    reactor_destroy(reactor);
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "config.h"
+#include "profiles.h"
+
+// ============================================================================
+// REPORT CAPTURE AND REPLAY
+// ============================================================================
+//
+// Capture file layout (host byte order):
+//   capture_header_t                 Magic "KD100CAP", version, record size
+//   capture_record_t...              One record per input report, keypad
+//                                    attach, profile switch or reload
+//
+// Replay feeds a capture through the same dispatcher as live input
+// (decode -> leader -> wheel -> actions), either at the recorded pace or
+// as fast as possible, with actions sent to a selectable handler sink.
+// A fast replay runs timers and time windows on the recorded timestamps
+// (see set_virtual_time_ms), so it makes the decisions a paced one does.
+// Timers still pending at the end run out before the keypads detach.
+// Profile switch and reload records switch or reload the profile manager
+// at the same point, and attach records bring back the USB port keypads
+// are bound to profiles by, so a session replays with the configs it was
+// recorded with.
+//
+// ============================================================================
+
+#define CAPTURE_MAGIC        "KD100CAP"
+#define CAPTURE_VERSION      1
+#define CAPTURE_REPORT_SIZE  40
+
+// Record kinds
+#define CAPTURE_RECORD_REPORT   0    // data: input report
+#define CAPTURE_RECORD_PROFILE  1    // data: name of the profile switched to
+#define CAPTURE_RECORD_ATTACH   2    // data: USB port of the keypad attached
+#define CAPTURE_RECORD_RELOAD   3    // data: profile file hot reload picked up
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} capture_header_t;
+
+typedef struct {
+    uint64_t timestamp_ns;           // CLOCK_MONOTONIC
+    uint8_t keypad;                  // Keypad slot the report came from
+    uint8_t length;                  // Valid bytes in data
+    uint8_t kind;                    // CAPTURE_RECORD_*
+    uint8_t reserved[5];
+    uint8_t data[CAPTURE_REPORT_SIZE];
+} capture_record_t;
+
+typedef struct {
+    FILE* file;
+    long records;
+} capture_t;
+
+// Recording
+capture_t* capture_open(const char* path);
+void capture_close(capture_t* capture);
+void capture_write(capture_t* capture, int keypad, const unsigned char* data, int length);
+void capture_write_profile(capture_t* capture, const char* name);
+void capture_write_attach(capture_t* capture, int keypad, const char* port);
+void capture_write_reload(capture_t* capture, const char* filename);
+
+// Replay a capture through the dispatcher. fast: don't wait for the
+// recorded timing.
+// Profile switch and reload records need profile_manager (may be NULL).
+// Returns 0 on success, -1 if the file could not be read.
+int capture_replay(const char* path, config_t* config, profile_manager_t* profile_manager,
+                   int debug, int fast);
+
+#endif // CAPTURE_H
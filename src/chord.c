@@ -0,0 +1,103 @@
+#include "chord.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// Parse one line into *chord. Returns 0, or -1 if it isn't valid.
+static int parse_chord(const char* text, int total_buttons, chord_t* chord) {
+    const char* equals = strchr(text, '=');
+    if (equals == NULL) return -1;
+
+    unsigned int mask = 0;
+    int buttons = 0;
+    const char* p = text;
+    while (p < equals) {
+        if (*p == ' ' || *p == '\t' || *p == '+') {
+            p++;
+            continue;
+        }
+        if (!isdigit((unsigned char)*p)) return -1;
+        char* end;
+        long button = strtol(p, &end, 10);
+        // The wheel button has its own multi-click handling
+        if (button < 0 || button >= 18 || button >= total_buttons || (mask & (1u << button))) {
+            return -1;
+        }
+        mask |= 1u << button;
+        buttons++;
+        p = end;
+    }
+    if (buttons < 2) return -1;
+
+    const char* keys = equals + 1;
+    while (*keys == ' ' || *keys == '\t') keys++;
+    if (*keys == '\0') return -1;
+    action_t* action = action_create(keys, 0);
+    if (action == NULL || action->kind != ACTION_KEYS) {
+        action_destroy(action);
+        return -1;
+    }
+
+    chord->mask = mask;
+    chord->action = action;
+    return 0;
+}
+
+chord_table_t* chord_table_create(char* const* chords, int count, int total_buttons) {
+    if (count == 0) return NULL;
+
+    chord_table_t* table = calloc(1, sizeof(chord_table_t));
+    if (table == NULL) return NULL;
+    table->chords = calloc(count, sizeof(chord_t));
+    if (table->chords == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        chord_t chord;
+        if (chords[i] == NULL) continue;
+        if (parse_chord(chords[i], total_buttons, &chord) < 0) {
+            printf("Chord: invalid chord \"%s\", ignored\n", chords[i]);
+            continue;
+        }
+
+        // A later line for the same buttons wins
+        chord_t* existing = (chord_t*)chord_find(table, chord.mask);
+        if (existing) {
+            action_destroy(existing->action);
+            existing->action = chord.action;
+            continue;
+        }
+        table->chords[table->count++] = chord;
+        table->members |= chord.mask;
+    }
+    return table;
+}
+
+void chord_table_destroy(chord_table_t* table) {
+    if (table == NULL) return;
+    for (int i = 0; i < table->count; i++) {
+        action_destroy(table->chords[i].action);
+    }
+    free(table->chords);
+    free(table);
+}
+
+const chord_t* chord_find(const chord_table_t* table, unsigned int mask) {
+    if (table == NULL) return NULL;
+    for (int i = 0; i < table->count; i++) {
+        if (table->chords[i].mask == mask) return &table->chords[i];
+    }
+    return NULL;
+}
+
+int chord_extends(const chord_table_t* table, unsigned int mask) {
+    if (table == NULL) return 0;
+    for (int i = 0; i < table->count; i++) {
+        unsigned int chord = table->chords[i].mask;
+        if ((chord & mask) == mask && chord != mask) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef CHORD_H
+#define CHORD_H
+
+#include "action.h"
+
+// ============================================================================
+// CHORDS
+// ============================================================================
+//
+// "chord: 3+5 = ctrl+shift+s" binds keys to buttons 3 and 5 pressed
+// together. A press of a button that is part of a chord is held back for
+// chord_window ms: if the other buttons of a chord go down in that window
+// only the chord's keys are sent, otherwise the held back presses are
+// handled as usual, in the order they came. A chord that isn't part of a
+// longer one is sent as soon as it is complete.
+//
+// Chords are compiled with the configuration into a table of button masks.
+//
+// ============================================================================
+
+#define CHORD_MAX_COUNT       128   // chord lines
+#define CHORD_WINDOW_DEFAULT  50    // ms
+#define CHORD_WINDOW_MIN      10
+#define CHORD_WINDOW_MAX      200
+
+typedef struct {
+    unsigned int mask;           // Bit n = button n
+    action_t* action;            // Keys sent for the chord
+} chord_t;
+
+typedef struct {
+    chord_t* chords;
+    int count;
+    unsigned int members;        // Buttons in any chord
+} chord_table_t;
+
+// Compile "<button>+<button>[+...] = <keys>" lines. Returns NULL if there
+// are none (invalid ones are reported and skipped).
+chord_table_t* chord_table_create(char* const* chords, int count, int total_buttons);
+void chord_table_destroy(chord_table_t* table);
+
+// Chord of exactly these buttons (NULL = none)
+const chord_t* chord_find(const chord_table_t* table, unsigned int mask);
+
+// 1 if a chord has all of these buttons and more
+int chord_extends(const chord_table_t* table, unsigned int mask);
+
+#endif // CHORD_H
@@ -1,10 +1,13 @@
 #include "compat.h"
+#include "device.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
 
 // Check if a kernel module is loaded
 int is_module_loaded(const char* module_name) {
@@ -13,40 +16,75 @@ int is_module_loaded(const char* module_name) {
     return (access(path, F_OK) == 0);
 }
 
-// Try to access device via hidraw (alternative to libusb)
+// Read the HID_ID of a hidraw node ("HID_ID=0003:0000256C:0000006D")
+static int hidraw_matches(const char* name) {
+    char path[512];
+    char buf[256];
+    int match = 0;
+
+    snprintf(path, sizeof(path), "/sys/class/hidraw/%s/device/uevent", name);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return 0;
+
+    while (fgets(buf, sizeof(buf), f)) {
+        unsigned int bus, vid, pid;
+        if (sscanf(buf, "HID_ID=%x:%x:%x", &bus, &vid, &pid) == 3) {
+            match = (vid == DEVICE_VID && pid == DEVICE_PID);
+            break;
+        }
+    }
+    fclose(f);
+    return match;
+}
+
+// Is this hidraw node on USB interface 0 (the one carrying key reports)?
+static int hidraw_is_interface0(const char* name) {
+    char path[512];
+    char real[PATH_MAX];
+
+    snprintf(path, sizeof(path), "/sys/class/hidraw/%s/device", name);
+    if (realpath(path, real) == NULL) return 0;
+    return strstr(real, ":1.0/") != NULL;
+}
+
+// Try to access device via hidraw (alternative to libusb).
+// Returns a non-blocking fd, preferring the node on interface 0.
 int try_hidraw_access(void) {
     DIR *dir;
     struct dirent *ent;
     char path[512];
-    char buf[256];
+    char fallback[512] = "";
 
     dir = opendir("/dev");
     if (dir == NULL) return -1;
 
+    path[0] = '\0';
     while ((ent = readdir(dir)) != NULL) {
-        if (strncmp(ent->d_name, "hidraw", 6) == 0) {
-            snprintf(path, sizeof(path), "/sys/class/hidraw/%s/device/uevent",
-                     ent->d_name);
-            FILE *f = fopen(path, "r");
-            if (f) {
-                while (fgets(buf, sizeof(buf), f)) {
-                    if (strstr(buf, "VID=256C") && strstr(buf, "PID=006D")) {
-                        snprintf(path, sizeof(path), "/dev/%s", ent->d_name);
-                        fclose(f);
-                        closedir(dir);
-                        int fd = open(path, O_RDWR);
-                        if (fd >= 0) {
-                            printf("Successfully opened device via hidraw\n");
-                            return fd;
-                        }
-                    }
-                }
-                fclose(f);
-            }
+        if (strncmp(ent->d_name, "hidraw", 6) != 0 || !hidraw_matches(ent->d_name)) {
+            continue;
+        }
+        if (hidraw_is_interface0(ent->d_name)) {
+            snprintf(path, sizeof(path), "/dev/%s", ent->d_name);
+            break;
+        }
+        if (fallback[0] == '\0') {
+            snprintf(fallback, sizeof(fallback), "/dev/%s", ent->d_name);
         }
     }
     closedir(dir);
-    return -1;
+
+    if (path[0] == '\0') {
+        if (fallback[0] == '\0') return -1;
+        strcpy(path, fallback);
+    }
+
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        printf("Unable to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    printf("Successfully opened device via hidraw (%s)\n", path);
+    return fd;
 }
 
 // Print compatibility warning
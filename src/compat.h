@@ -7,6 +7,7 @@
 int is_module_loaded(const char* module_name);
 
 // Try to access device via hidraw (alternative to libusb)
+// Returns a non-blocking fd or -1
 int try_hidraw_access(void);
 
 // Print compatibility warning
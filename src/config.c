@@ -26,6 +26,30 @@ static wheel_mode_t parse_wheel_mode(const char* mode_str) {
     return WHEEL_MODE_SEQUENTIAL;
 }
 
+const char* injection_backend_to_string(injection_backend_t backend) {
+    switch (backend) {
+        case INJECTION_XTEST: return "xtest";
+        case INJECTION_XDOTOOL: return "xdotool";
+        case INJECTION_XDOTOOL_PIPE: return "xdotool_pipe";
+        case INJECTION_UINPUT: return "uinput";
+        default: return "unknown";
+    }
+}
+
+// Unknown names keep the default
+static injection_backend_t parse_injection_backend(const char* str) {
+    if (strncasecmp(str, "xdotool_pipe", 12) == 0) {
+        return INJECTION_XDOTOOL_PIPE;
+    }
+    if (strncasecmp(str, "xdotool", 7) == 0) {
+        return INJECTION_XDOTOOL;
+    }
+    if (strncasecmp(str, "uinput", 6) == 0) {
+        return INJECTION_UINPUT;
+    }
+    return INJECTION_XTEST;
+}
+
 // Helper function to strip inline comments (// ...) and trailing whitespace
 static char* strip_inline_comment(char* str) {
     if (str == NULL) return NULL;
@@ -107,23 +131,40 @@ config_t* config_create(void) {
     config->totalButtons = 0;
     config->totalWheels = 0;
     config->enable_uclogic = 0;
+    config->hotplug = 1;
+    config->injection_backend = INJECTION_XTEST;
     config->wheel_click_timeout_ms = 300;  // 300ms default timeout
+    config->wheel_coalesce_ms = 30;        // Batch wheel ticks within 30ms
+    config->launch_limit = LAUNCH_LIMIT_DEFAULT;
+    config->plugin_dir = NULL;
+    config->key_hold_ms = 10;              // Key down to key up of a type 0 press
+    config->repeat_delay_ms = 500;         // Autorepeat of held buttons
+    config->repeat_rate = 25;
     config->wheel_mode = WHEEL_MODE_SEQUENTIAL;  // Default to sequential (legacy behavior)
 
     // Initialize leader state
     config->leader.leader_button = -1;
     config->leader.leader_active = 0;
     config->leader.last_button = -1;
-    config->leader.leader_press_time.tv_sec = 0;
-    config->leader.leader_press_time.tv_usec = 0;
+    config->leader.leader_press_ms = 0;
     config->leader.leader_function = NULL;
     config->leader.timeout_ms = 1000;  // 1 second default timeout
     config->leader.mode = LEADER_MODE_ONE_SHOT;  // Default mode
     config->leader.toggle_state = 0;
+    config->leader.sequence_node = 0;
+    config->leader_sequences = NULL;
+    config->leader_sequence_count = 0;
+    config->leader_trie = NULL;
+    config->chords = NULL;
+    config->chord_count = 0;
+    config->chord_table = NULL;
+    config->chord_window_ms = CHORD_WINDOW_DEFAULT;
 
     config->wheelEvents[0].right = NULL;
     config->wheelEvents[0].left = NULL;
     config->wheelEvents[0].description = NULL;
+    config->wheelEvents[0].right_action = NULL;
+    config->wheelEvents[0].left_action = NULL;
 
     // Initialize OSD settings
     config->osd.enabled = 0;
@@ -145,6 +186,8 @@ config_t* config_create(void) {
     config->profile.profiles_dir = NULL;
     config->profile.auto_switch = 1;  // Enabled by default
     config->profile.check_interval_ms = 500;
+    config->device_binding_count = 0;
+    config->refs = 1;
 
     // Initialize key descriptions
     for (int i = 0; i < 19; i++) {
@@ -155,15 +198,23 @@ config_t* config_create(void) {
     return config;
 }
 
+config_t* config_ref(config_t* config) {
+    if (config) config->refs++;
+    return config;
+}
+
 // Destroy configuration and free memory
 void config_destroy(config_t* config) {
-    if (config == NULL) return;
+    if (config == NULL || --config->refs > 0) return;
 
     // Free button events
     for (int i = 0; i < config->totalButtons; i++) {
         if (config->events[i].function != NULL) {
             free(config->events[i].function);
         }
+        action_destroy(config->events[i].action);
+        free(config->events[i].hold_function);
+        action_destroy(config->events[i].hold_action);
     }
     free(config->events);
 
@@ -178,6 +229,8 @@ void config_destroy(config_t* config) {
         if (config->wheelEvents[i].description != NULL) {
             free(config->wheelEvents[i].description);
         }
+        action_destroy(config->wheelEvents[i].right_action);
+        action_destroy(config->wheelEvents[i].left_action);
     }
     free(config->wheelEvents);
 
@@ -185,6 +238,16 @@ void config_destroy(config_t* config) {
     if (config->leader.leader_function != NULL) {
         free(config->leader.leader_function);
     }
+    for (int i = 0; i < config->leader_sequence_count; i++) {
+        free(config->leader_sequences[i]);
+    }
+    free(config->leader_sequences);
+    leader_trie_destroy(config->leader_trie);
+    for (int i = 0; i < config->chord_count; i++) {
+        free(config->chords[i]);
+    }
+    free(config->chords);
+    chord_table_destroy(config->chord_table);
 
     // Free profile settings
     if (config->profile.profiles_file != NULL) {
@@ -193,6 +256,11 @@ void config_destroy(config_t* config) {
     if (config->profile.profiles_dir != NULL) {
         free(config->profile.profiles_dir);
     }
+    free(config->plugin_dir);
+    for (int i = 0; i < config->device_binding_count; i++) {
+        free(config->device_bindings[i].port);
+        free(config->device_bindings[i].profile);
+    }
 
     // Free key descriptions
     for (int i = 0; i < 19; i++) {
@@ -266,6 +334,20 @@ int config_load(config_t* config, const char* filename, int debug) {
             continue;
         }
 
+        // Parse hotplug
+        if (strncasecmp(line, "hotplug:", 8) == 0) {
+            char* value = line + 8;
+            while (*value == ' ') value++;
+            if (strncasecmp(value, "true", 4) == 0) {
+                config->hotplug = 1;
+                if (debug) printf("Config: hotplug = true\n");
+            } else if (strncasecmp(value, "false", 5) == 0) {
+                config->hotplug = 0;
+                if (debug) printf("Config: hotplug = false\n");
+            }
+            continue;
+        }
+
         // Parse wheel_click_timeout
         if (strncasecmp(line, "wheel_click_timeout:", 20) == 0) {
             char* value = line + 20;
@@ -279,6 +361,77 @@ int config_load(config_t* config, const char* filename, int debug) {
             continue;
         }
 
+        // Parse launch_limit
+        if (strncasecmp(line, "launch_limit:", 13) == 0) {
+            char* value = line + 13;
+            while (*value == ' ') value++;
+            int limit = atoi(value);
+            if (limit < 1) limit = 1;
+            if (limit > LAUNCH_LIMIT_MAX) limit = LAUNCH_LIMIT_MAX;
+            config->launch_limit = limit;
+            if (debug) printf("Config: launch_limit = %d\n", config->launch_limit);
+            continue;
+        }
+
+        // Parse injection_backend
+        if (strncasecmp(line, "injection_backend:", 18) == 0) {
+            char* value = line + 18;
+            while (*value == ' ') value++;
+            config->injection_backend = parse_injection_backend(value);
+            if (debug) printf("Config: injection_backend = %s\n",
+                              injection_backend_to_string(config->injection_backend));
+            continue;
+        }
+
+        // Parse key_hold
+        if (strncasecmp(line, "key_hold:", 9) == 0) {
+            char* value = line + 9;
+            while (*value == ' ') value++;
+            int hold = atoi(value);
+            if (hold < 0) hold = 0;
+            if (hold > 500) hold = 500;
+            config->key_hold_ms = hold;
+            if (debug) printf("Config: key_hold = %d ms\n", config->key_hold_ms);
+            continue;
+        }
+
+        // Parse repeat_delay
+        if (strncasecmp(line, "repeat_delay:", 13) == 0) {
+            char* value = line + 13;
+            while (*value == ' ') value++;
+            int delay = atoi(value);
+            if (delay < 50) delay = 50;
+            if (delay > 2000) delay = 2000;
+            config->repeat_delay_ms = delay;
+            if (debug) printf("Config: repeat_delay = %d ms\n", config->repeat_delay_ms);
+            continue;
+        }
+
+        // Parse repeat_rate
+        if (strncasecmp(line, "repeat_rate:", 12) == 0) {
+            char* value = line + 12;
+            while (*value == ' ') value++;
+            int rate = atoi(value);
+            if (rate < 1) rate = 1;
+            if (rate > 100) rate = 100;
+            config->repeat_rate = rate;
+            if (debug) printf("Config: repeat_rate = %d/s\n", config->repeat_rate);
+            continue;
+        }
+
+        // Parse wheel_coalesce
+        if (strncasecmp(line, "wheel_coalesce:", 15) == 0) {
+            char* value = line + 15;
+            while (*value == ' ') value++;
+            int window = atoi(value);
+            // 0 disables coalescing; cap the added latency at 200ms
+            if (window < 0) window = 0;
+            if (window > 200) window = 200;
+            config->wheel_coalesce_ms = window;
+            if (debug) printf("Config: wheel_coalesce = %d ms\n", config->wheel_coalesce_ms);
+            continue;
+        }
+
         // Parse wheel_mode
         if (strncasecmp(line, "wheel_mode:", 11) == 0) {
             char* value = line + 11;
@@ -327,6 +480,51 @@ int config_load(config_t* config, const char* filename, int debug) {
             continue;
         }
 
+        // Parse leader_sequence (buttons after the leader = keys)
+        if (strncasecmp(line, "leader_sequence:", 16) == 0) {
+            char* value = line + 16;
+            while (*value == ' ') value++;
+            if (config->leader_sequence_count >= LEADER_SEQUENCE_MAX_COUNT) {
+                printf("Config: more than %d leader sequences, ignoring \"%s\"\n",
+                       LEADER_SEQUENCE_MAX_COUNT, value);
+                continue;
+            }
+            char** sequences = realloc(config->leader_sequences,
+                                       (config->leader_sequence_count + 1) * sizeof(char*));
+            if (sequences == NULL) continue;
+            config->leader_sequences = sequences;
+            config->leader_sequences[config->leader_sequence_count++] = strdup(value);
+            if (debug) printf("Config: leader_sequence = %s\n", value);
+            continue;
+        }
+
+        // Parse chord (buttons pressed together = keys)
+        if (strncasecmp(line, "chord:", 6) == 0) {
+            char* value = line + 6;
+            while (*value == ' ') value++;
+            if (config->chord_count >= CHORD_MAX_COUNT) {
+                printf("Config: more than %d chords, ignoring \"%s\"\n", CHORD_MAX_COUNT, value);
+                continue;
+            }
+            char** chords = realloc(config->chords, (config->chord_count + 1) * sizeof(char*));
+            if (chords == NULL) continue;
+            config->chords = chords;
+            config->chords[config->chord_count++] = strdup(value);
+            if (debug) printf("Config: chord = %s\n", value);
+            continue;
+        }
+
+        if (strncasecmp(line, "chord_window:", 13) == 0) {
+            char* value = line + 13;
+            while (*value == ' ') value++;
+            int ms = atoi(value);
+            if (ms < CHORD_WINDOW_MIN) ms = CHORD_WINDOW_MIN;
+            if (ms > CHORD_WINDOW_MAX) ms = CHORD_WINDOW_MAX;
+            config->chord_window_ms = ms;
+            if (debug) printf("Config: chord_window = %d ms\n", config->chord_window_ms);
+            continue;
+        }
+
         // Parse OSD settings
         if (strncasecmp(line, "osd_enabled:", 12) == 0) {
             char* value = line + 12;
@@ -435,6 +633,15 @@ int config_load(config_t* config, const char* filename, int debug) {
             continue;
         }
 
+        if (strncasecmp(line, "plugin_dir:", 11) == 0) {
+            char* value = line + 11;
+            while (*value == ' ') value++;
+            free(config->plugin_dir);
+            config->plugin_dir = strdup(value);
+            if (debug) printf("Config: plugin_dir = %s\n", config->plugin_dir);
+            continue;
+        }
+
         if (strncasecmp(line, "profile_auto_switch:", 20) == 0) {
             char* value = line + 20;
             while (*value == ' ') value++;
@@ -451,6 +658,25 @@ int config_load(config_t* config, const char* filename, int debug) {
             continue;
         }
 
+        // Parse device_profile: <usb port> <profile name>
+        if (strncasecmp(line, "device_profile:", 15) == 0) {
+            char* value = line + 15;
+            while (*value == ' ') value++;
+            char* name = strchr(value, ' ');
+            if (name == NULL || config->device_binding_count >= MAX_DEVICE_BINDINGS) {
+                printf("Config: ignoring device_profile '%s'\n", value);
+                continue;
+            }
+            *name++ = '\0';
+            while (*name == ' ') name++;
+            trim_trailing_spaces(name);
+            device_binding_t* binding = &config->device_bindings[config->device_binding_count++];
+            binding->port = strdup(value);
+            binding->profile = strdup(name);
+            if (debug) printf("Config: device_profile %s -> %s\n", binding->port, binding->profile);
+            continue;
+        }
+
         // Parse key descriptions (description_0, description_1, etc.)
         if (strncasecmp(line, "description_", 12) == 0) {
             char* num_str = line + 12;
@@ -509,6 +735,8 @@ int config_load(config_t* config, const char* filename, int debug) {
                                 config->wheelEvents[j].right = NULL;
                                 config->wheelEvents[j].left = NULL;
                                 config->wheelEvents[j].description = NULL;
+                                config->wheelEvents[j].right_action = NULL;
+                                config->wheelEvents[j].left_action = NULL;
                             }
                         }
                     }
@@ -539,6 +767,13 @@ int config_load(config_t* config, const char* filename, int debug) {
                     config->events[j].function = NULL;
                     config->events[j].type = 0;
                     config->events[j].leader_eligible = -1;  // Default: not set
+                    config->events[j].action = NULL;
+                    config->events[j].launch_policy = LAUNCH_QUEUE;
+                    config->events[j].hold_mode = HOLD_MODE_TAP;
+                    config->events[j].hold_function = NULL;
+                    config->events[j].hold_action = NULL;
+                    config->events[j].hold_threshold_ms = 200;
+                    config->events[j].tap_hold_mode = TAP_HOLD_TIMEOUT;
                 }
                 config->totalButtons = button + 1;
             }
@@ -568,6 +803,61 @@ int config_load(config_t* config, const char* filename, int debug) {
             continue;
         }
 
+        // Parse hold_mode
+        if (strncasecmp(line, "hold_mode:", 10) == 0 && button != -1) {
+            char* value = line + 10;
+            while (*value == ' ') value++;
+            strip_inline_comment(value);
+            config->events[button].hold_mode = parse_hold_mode(value);
+            if (debug) printf("Config: button %d hold_mode = %s\n", button,
+                              hold_mode_to_string(config->events[button].hold_mode));
+            continue;
+        }
+
+        // Parse hold_function (tap-hold: what holding the button does)
+        if (strncasecmp(line, "hold_function:", 14) == 0 && button != -1) {
+            char* value = line + 14;
+            while (*value == ' ') value++;
+            free(config->events[button].hold_function);
+            config->events[button].hold_function = *value ? strdup(value) : NULL;
+            if (debug) printf("Config: button %d hold_function = %s\n", button, value);
+            continue;
+        }
+
+        // Parse hold_threshold
+        if (strncasecmp(line, "hold_threshold:", 15) == 0 && button != -1) {
+            char* value = line + 15;
+            while (*value == ' ') value++;
+            int threshold = atoi(value);
+            if (threshold < 50) threshold = 50;
+            if (threshold > 1000) threshold = 1000;
+            config->events[button].hold_threshold_ms = threshold;
+            if (debug) printf("Config: button %d hold_threshold = %d ms\n", button, threshold);
+            continue;
+        }
+
+        // Parse tap_hold_mode
+        if (strncasecmp(line, "tap_hold_mode:", 14) == 0 && button != -1) {
+            char* value = line + 14;
+            while (*value == ' ') value++;
+            strip_inline_comment(value);
+            config->events[button].tap_hold_mode = parse_tap_hold_mode(value);
+            if (debug) printf("Config: button %d tap_hold_mode = %s\n", button,
+                              tap_hold_mode_to_string(config->events[button].tap_hold_mode));
+            continue;
+        }
+
+        // Parse launch_policy
+        if (strncasecmp(line, "launch_policy:", 14) == 0 && button != -1) {
+            char* value = line + 14;
+            while (*value == ' ') value++;
+            config->events[button].launch_policy =
+                strncasecmp(value, "drop", 4) == 0 ? LAUNCH_DROP : LAUNCH_QUEUE;
+            if (debug) printf("Config: button %d launch_policy = %s\n", button,
+                              launch_policy_to_string(config->events[button].launch_policy));
+            continue;
+        }
+
         // Parse function
         if (strncasecmp(line, "function:", 9) == 0) {
             char* func_str = line + 9;
@@ -607,6 +897,8 @@ int config_load(config_t* config, const char* filename, int debug) {
                     config->wheelEvents[rightWheels].right = func_copy;
                     config->wheelEvents[rightWheels].left = NULL;
                     config->wheelEvents[rightWheels].description = NULL;
+                    config->wheelEvents[rightWheels].right_action = NULL;
+                    config->wheelEvents[rightWheels].left_action = NULL;
                 } else {
                     config->wheelEvents[0].right = func_copy;
                     config->wheelEvents[0].left = NULL;
@@ -630,6 +922,8 @@ int config_load(config_t* config, const char* filename, int debug) {
                     config->wheelEvents[leftWheels].left = func_copy;
                     config->wheelEvents[leftWheels].right = NULL;
                     config->wheelEvents[leftWheels].description = NULL;
+                    config->wheelEvents[leftWheels].right_action = NULL;
+                    config->wheelEvents[leftWheels].left_action = NULL;
                 }
                 leftWheels++;
             }
@@ -663,9 +957,43 @@ int config_load(config_t* config, const char* filename, int debug) {
     else
         config->totalWheels = leftWheels;
 
+    config_compile_actions(config);
     return 0;
 }
 
+void config_compile_actions(config_t* config) {
+    for (int i = 0; i < config->totalButtons; i++) {
+        event* ev = &config->events[i];
+        action_destroy(ev->action);
+        ev->action = action_create(ev->function, ev->type);
+        action_set_leader(ev->action, config->leader.leader_function);
+        action_destroy(ev->hold_action);
+        ev->hold_action = NULL;
+        // Only keys and mouse buttons can be held; the wheel button can't tap-hold
+        if (ev->hold_function && i != 18) {
+            ev->hold_action = action_create(ev->hold_function, 0);
+            if (ev->hold_action && ev->hold_action->kind != ACTION_KEYS &&
+                ev->hold_action->kind != ACTION_MOUSE) {
+                printf("Button %d: hold_function \"%s\" can't be held, ignored\n", i, ev->hold_function);
+                action_destroy(ev->hold_action);
+                ev->hold_action = NULL;
+            }
+        }
+    }
+    for (int i = 0; i < config->totalWheels; i++) {
+        wheel* wh = &config->wheelEvents[i];
+        action_destroy(wh->right_action);
+        action_destroy(wh->left_action);
+        wh->right_action = action_create(wh->right, 0);
+        wh->left_action = action_create(wh->left, 0);
+    }
+    leader_trie_destroy(config->leader_trie);
+    config->leader_trie = leader_trie_create(config->leader_sequences, config->leader_sequence_count,
+                                             config->events, config->totalButtons);
+    chord_table_destroy(config->chord_table);
+    config->chord_table = chord_table_create(config->chords, config->chord_count, config->totalButtons);
+}
+
 // Print configuration (for debugging)
 void config_print(const config_t* config, int debug) {
     if (config == NULL || debug == 0) return;
@@ -698,11 +1026,41 @@ void config_print(const config_t* config, int debug) {
     printf("Leader function: '%s'\n", config->leader.leader_function ? config->leader.leader_function : "(null)");
     printf("Leader timeout: %d ms\n", config->leader.timeout_ms);
     printf("Leader mode: %s\n", leader_mode_to_string(config->leader.mode));
+    for (int i = 0; i < config->leader_sequence_count; i++) {
+        printf("Leader sequence: %s\n", config->leader_sequences[i]);
+    }
+    for (int i = 0; i < config->chord_count; i++) {
+        printf("Chord: %s\n", config->chords[i]);
+    }
+    printf("Chord window: %d ms\n", config->chord_window_ms);
 
     printf("\n=== Wheel Click Configuration ===\n");
     printf("Multi-click timeout: %d ms\n", config->wheel_click_timeout_ms);
+    printf("Tick coalescing window: %d ms\n", config->wheel_coalesce_ms);
     printf("Wheel mode: %s\n", wheel_mode_to_string(config->wheel_mode));
 
+    printf("\n=== Injection ===\n");
+    printf("Backend: %s\n", injection_backend_to_string(config->injection_backend));
+    printf("Key hold: %d ms\n", config->key_hold_ms);
+    printf("Autorepeat: after %d ms, %d/s\n", config->repeat_delay_ms, config->repeat_rate);
+    for (int i = 0; i < config->totalButtons; i++) {
+        if (config->events[i].hold_mode != HOLD_MODE_TAP) {
+            printf("Button %2d hold mode: %s\n", i, hold_mode_to_string(config->events[i].hold_mode));
+        }
+        if (config->events[i].hold_function) {
+            printf("Button %2d tap-hold: %s after %d ms (%s)\n", i, config->events[i].hold_function,
+                   config->events[i].hold_threshold_ms,
+                   tap_hold_mode_to_string(config->events[i].tap_hold_mode));
+        }
+    }
+    printf("Programs running at once: %d\n", config->launch_limit);
+    printf("Plugin dir: %s\n", config->plugin_dir ? config->plugin_dir : "(none)");
+    for (int i = 0; i < config->totalButtons; i++) {
+        if (config->events[i].type == 1 && config->events[i].launch_policy != LAUNCH_QUEUE) {
+            printf("Button %2d launch policy: %s\n", i, launch_policy_to_string(config->events[i].launch_policy));
+        }
+    }
+
     printf("\n=== OSD Configuration ===\n");
     printf("OSD enabled: %s\n", config->osd.enabled ? "yes" : "no");
     printf("Start visible: %s\n", config->osd.start_visible ? "yes" : "no");
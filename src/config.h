@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include "leader.h"
+#include "chord.h"
 
 // Wheel mode enumeration
 typedef enum {
@@ -9,6 +10,14 @@ typedef enum {
     WHEEL_MODE_SETS         // Multi-click for set-based navigation
 } wheel_mode_t;
 
+// Key / mouse injection backend
+typedef enum {
+    INJECTION_XTEST,        // In-process XTest on a persistent display connection (default)
+    INJECTION_XDOTOOL,      // Run xdotool through the shell for every event (legacy)
+    INJECTION_XDOTOOL_PIPE, // Stream commands to a coprocess that runs xdotool for each
+    INJECTION_UINPUT        // Virtual keyboard/mouse via /dev/uinput (X11, Wayland, console)
+} injection_backend_t;
+
 // Maximum length for description fields (prevents buffer overflow)
 #define MAX_DESCRIPTION_LEN 64
 
@@ -17,6 +26,8 @@ typedef struct {
     char* right;
     char* left;
     char* description;  // Human-readable name for this wheel function pair (e.g., "Brush Size")
+    action_t* right_action;  // Compiled right/left (NULL if none)
+    action_t* left_action;
 } wheel;
 
 // OSD configuration
@@ -44,6 +55,15 @@ typedef struct {
     int check_interval_ms;    // How often to check active window (default 500ms)
 } profile_config_t;
 
+// Maximum number of device_profile bindings
+#define MAX_DEVICE_BINDINGS 8
+
+// Binds the keypad on a USB port to a fixed profile
+typedef struct {
+    char* port;               // USB port path, e.g. "1-4.2" (see -d output)
+    char* profile;            // Profile name
+} device_binding_t;
+
 // Configuration structure
 typedef struct {
     event* events;
@@ -51,19 +71,48 @@ typedef struct {
     wheel* wheelEvents;
     int totalWheels;
     leader_state leader;
+    char** leader_sequences;     // leader_sequence lines
+    int leader_sequence_count;
+    leader_trie_t* leader_trie;  // Compiled leader_sequences (NULL = none)
+    char** chords;               // chord lines
+    int chord_count;
+    chord_table_t* chord_table;  // Compiled chords (NULL = none)
+    int chord_window_ms;         // Wait for the rest of a chord (10-200ms)
     int enable_uclogic;
+    int hotplug;                 // Use libusb hotplug events (fallback: rescan)
+    injection_backend_t injection_backend;
     int wheel_click_timeout_ms;  // Multi-click detection timeout (20-990ms)
+    int wheel_coalesce_ms;       // Window for batching wheel ticks (0 = off, max 200ms)
+    int launch_limit;            // Type 1 programs running at once (1-64)
+    char* plugin_dir;            // Directory of action plugins (NULL = none)
+    int key_hold_ms;             // Type 0 key down to key up (0-500ms)
+    int repeat_delay_ms;         // hold_mode repeat: first repeat after (50-2000ms)
+    int repeat_rate;             // hold_mode repeat: presses per second (1-100)
     wheel_mode_t wheel_mode;     // Wheel toggle mode (sequential or sets)
     osd_config_t osd;            // OSD settings
     profile_config_t profile;    // Profile settings
+    device_binding_t device_bindings[MAX_DEVICE_BINDINGS]; // Per-keypad profile bindings
+    int device_binding_count;
     char* key_descriptions[19];         // Per-button descriptions (for default profile)
     char* leader_descriptions[19];      // Per-button descriptions when leader is active
+    int refs;                    // The owner and keypads still using its actions
 } config_t;
 
 // Configuration functions
 config_t* config_create(void);
+
+// Keep a config (its actions) valid past a profile switch or reload that
+// frees it; config_destroy() drops the reference
+config_t* config_ref(config_t* config);
+
+// Drop a reference; the config is freed with the last one
 void config_destroy(config_t* config);
 int config_load(config_t* config, const char* filename, int debug);
 void config_print(const config_t* config, int debug);
 
+// Compile every function string into an action program (see action.h).
+// Done by config_load(); needed again after the strings are changed.
+void config_compile_actions(config_t* config);
+const char* injection_backend_to_string(injection_backend_t backend);
+
 #endif // CONFIG_H
@@ -0,0 +1,182 @@
+#include "decode.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Report byte and bit carrying each button
+static const struct {
+    int group;     // 0 = data[4], 1 = data[5], 2 = data[6]
+    int bit;
+} BUTTON_BITS[DECODE_BUTTON_COUNT] = {
+    {0, 0}, {0, 1}, {0, 2}, {0, 3}, {0, 4}, {0, 5}, {0, 6}, {0, 7},
+    {1, 0}, {1, 1}, {1, 2}, {1, 3}, {1, 4}, {1, 5}, {1, 6}, {1, 7},
+    {2, 0}, {2, 1}, {2, 2}
+};
+
+// Wheel report marker in data[1]
+#define WHEEL_REPORT_ID 241
+
+static signed char button_table[3][256];   // Byte value -> single button index (-1 = none)
+static unsigned int mask_table[3][256];    // Byte value -> bitmask of held buttons
+static signed char wheel_table[256];       // data[5] of a wheel report -> direction
+static int tables_ready = 0;
+
+void decode_init(void) {
+    if (tables_ready) return;
+
+    memset(button_table, -1, sizeof(button_table));
+    memset(mask_table, 0, sizeof(mask_table));
+    memset(wheel_table, 0, sizeof(wheel_table));
+
+    for (int b = 0; b < DECODE_BUTTON_COUNT; b++) {
+        int group = BUTTON_BITS[b].group;
+        unsigned int value = 1u << BUTTON_BITS[b].bit;
+
+        // Only a byte with exactly this bit set names a single button
+        button_table[group][value] = (signed char)b;
+
+        for (unsigned int v = 0; v < 256; v++) {
+            if (v & value) {
+                mask_table[group][v] |= 1u << b;
+            }
+        }
+    }
+
+    wheel_table[1] = 1;    // Clockwise
+    wheel_table[2] = -1;   // Counter-clockwise
+
+    tables_ready = 1;
+}
+
+void decode_report(const unsigned char* data, int length, decoded_report_t* out) {
+    out->kind = DECODE_NONE;
+    out->button = -1;
+    out->direction = 0;
+    out->mask = 0;
+    out->has_buttons = 0;
+
+    if (length < DECODE_MIN_LENGTH) return;
+
+    if (data[1] == WHEEL_REPORT_ID) {
+        // A wheel report carrying button bits in data[4] is not a tick
+        if (data[4] == 0 && wheel_table[data[5]] != 0) {
+            out->kind = DECODE_WHEEL;
+            out->direction = wheel_table[data[5]];
+        }
+        return;
+    }
+
+    out->mask = mask_table[0][data[4]] | mask_table[1][data[5]] | mask_table[2][data[6]];
+    out->has_buttons = 1;
+
+    // The first non-zero byte names the button, as the keypad only ever
+    // reports one group at a time
+    int button;
+    if (data[4] != 0) {
+        button = button_table[0][data[4]];
+    } else if (data[5] != 0) {
+        button = button_table[1][data[5]];
+    } else {
+        button = button_table[2][data[6]];
+    }
+
+    if (button >= 0) {
+        out->kind = DECODE_BUTTON;
+        out->button = button;
+    }
+}
+
+// ============================================================================
+// Benchmark
+// ============================================================================
+
+// The decoder this module replaced: keycode if-chain plus linear search
+static const int LEGACY_KEYCODES[] = {1, 2, 4, 8, 16, 32, 64, 128, 129, 130, 132, 136,
+                                      144, 160, 192, 256, 257, 258, 260, 641, 642};
+
+// Returns button index, 100 (clockwise), 101 (counter-clockwise) or -1
+static int legacy_decode(const unsigned char* data) {
+    int keycode = 0;
+    if (data[4] != 0)
+        keycode = data[4];
+    else if (data[5] != 0)
+        keycode = data[5] + 128;
+    else if (data[6] != 0)
+        keycode = data[6] + 256;
+    if (data[1] == WHEEL_REPORT_ID)
+        keycode += 512;
+
+    if (keycode == 641) return 100;
+    if (keycode == 642) return 101;
+    for (int k = 0; k < 19; k++) {
+        if (LEGACY_KEYCODES[k] == keycode) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static int table_decode(const unsigned char* data) {
+    decoded_report_t report;
+    decode_report(data, DECODE_MIN_LENGTH, &report);
+    if (report.kind == DECODE_WHEEL) return report.direction > 0 ? 100 : 101;
+    return report.button;
+}
+
+static double elapsed_ns(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+#define BENCH_REPORTS 64
+
+void decode_benchmark(int iterations) {
+    unsigned char reports[BENCH_REPORTS][8];
+    volatile int sink = 0;
+
+    decode_init();
+    if (iterations <= 0) iterations = 10000000;
+
+    // Typical traffic: every key press followed by its release, plus wheel ticks
+    memset(reports, 0, sizeof(reports));
+    for (int i = 0; i < BENCH_REPORTS; i++) {
+        unsigned char* r = reports[i];
+        r[0] = 1;
+        if (i % 2 == 1) continue;            // Release
+        int n = (i / 2) % (DECODE_BUTTON_COUNT + 2);
+        if (n >= DECODE_BUTTON_COUNT) {
+            r[1] = WHEEL_REPORT_ID;
+            r[5] = (unsigned char)(n - DECODE_BUTTON_COUNT + 1);
+        } else {
+            r[4 + BUTTON_BITS[n].group] = (unsigned char)(1u << BUTTON_BITS[n].bit);
+        }
+    }
+
+    // Both decoders must agree before timing them
+    int mismatches = 0;
+    for (int i = 0; i < BENCH_REPORTS; i++) {
+        if (legacy_decode(reports[i]) != table_decode(reports[i])) {
+            mismatches++;
+        }
+    }
+
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < iterations; i++) {
+        sink += legacy_decode(reports[i & (BENCH_REPORTS - 1)]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < iterations; i++) {
+        sink += table_decode(reports[i & (BENCH_REPORTS - 1)]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+
+    double legacy_ns = elapsed_ns(t0, t1) / iterations;
+    double table_ns = elapsed_ns(t1, t2) / iterations;
+
+    printf("Decode benchmark: %d reports\n", iterations);
+    printf("  if-chain + linear scan: %6.2f ns/report\n", legacy_ns);
+    printf("  lookup tables:          %6.2f ns/report (%.1fx)\n",
+           table_ns, table_ns > 0 ? legacy_ns / table_ns : 0.0);
+    printf("  decoder mismatches:     %d\n", mismatches);
+    (void)sink;
+}
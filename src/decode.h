@@ -0,0 +1,48 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+// ============================================================================
+// REPORT DECODER
+// ============================================================================
+//
+// KD100 input report layout (bytes of interest):
+//   data[1] == 241  Wheel report, data[5] = 1 (clockwise) or 2 (counter-clockwise)
+//   data[4]         Buttons 0-7, one bit each
+//   data[5]         Buttons 8-15, one bit each
+//   data[6]         Buttons 16-18 (bits 0-2; button 18 is the wheel button)
+//
+// decode_init() precomputes one lookup table per report byte, so decoding a
+// report is a handful of array lookups instead of a compare chain and a
+// linear keycode search.
+//
+// ============================================================================
+
+#define DECODE_BUTTON_COUNT 19
+#define DECODE_MIN_LENGTH   7    // Reports shorter than this are ignored
+
+// Kind of a decoded report
+typedef enum {
+    DECODE_NONE,      // Release, unknown or multi-button report
+    DECODE_BUTTON,    // Exactly one button pressed
+    DECODE_WHEEL      // Wheel tick
+} decode_kind_t;
+
+// Decoded report
+typedef struct {
+    decode_kind_t kind;
+    int button;             // Button index (0-18) for DECODE_BUTTON, else -1
+    int direction;          // +1 clockwise, -1 counter-clockwise (DECODE_WHEEL)
+    unsigned int mask;      // Bitmask of every button held in this report
+    int has_buttons;        // mask is the button state (not a wheel report)
+} decoded_report_t;
+
+// Build the lookup tables (idempotent)
+void decode_init(void);
+
+// Decode one report (length >= DECODE_MIN_LENGTH)
+void decode_report(const unsigned char* data, int length, decoded_report_t* out);
+
+// Compare the table decoder against the old if-chain + linear scan
+void decode_benchmark(int iterations);
+
+#endif // DECODE_H
@@ -9,6 +9,9 @@
 #define DEVICE_PID 0x006d
 
 // Device management functions
-void device_run(libusb_context* ctx, config_t* config, int debug, int accept, int dry);
+// capture_path: record raw reports to this file (NULL = off)
+// simulate: drive simulated keypads from this spec instead of USB (NULL = off)
+void device_run(libusb_context* ctx, config_t* config, int debug, int accept, int dry,
+                const char* capture_path, const char* simulate);
 
 #endif // DEVICE_H
@@ -0,0 +1,934 @@
+#include "dispatch.h"
+#include "handler.h"
+#include "utils.h"
+#include "decode.h"
+#include "latency.h"
+#include "macro.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void keypad_refresh_config(keypad_t* kp);
+
+// Resolve a finished button 18 multi-click sequence (sets mode).
+// force: the click timer fired, resolve regardless of ms rounding
+static void process_pending_clicks(keypad_t* kp, int force) {
+    dispatcher_t* d = kp->dispatcher;
+
+    if (d->config->wheel_mode == WHEEL_MODE_SETS && kp->button18_click_count > 0 &&
+        kp->last_button18_ms != 0) {
+        long time_since_last_click = get_time_ms() - kp->last_button18_ms;
+
+        // If timeout has expired, process the accumulated clicks
+        if (force || time_since_last_click >= d->config->wheel_click_timeout_ms) {
+            int final_click_count = kp->button18_click_count;
+            kp->button18_click_count = 0;
+            kp->last_button18_ms = 0;
+
+            if (d->debug == 1) {
+                printf("Sets mode - Button 18 clicks: %d\n", final_click_count);
+            }
+
+            // Process based on click count
+            if (final_click_count == 1) {
+                // Single-click: toggle within current set
+                kp->wheel_position_in_set = 1 - kp->wheel_position_in_set;
+            } else if (final_click_count == 2) {
+                // Double-click: toggle between Set 0 and Set 1
+                if (kp->wheel_current_set == 0) {
+                    kp->wheel_current_set = 1;
+                } else if (kp->wheel_current_set == 1) {
+                    kp->wheel_current_set = 0;
+                } else {
+                    // From Set 2, go to Set 1 (not Set 0)
+                    kp->wheel_current_set = 1;
+                }
+                kp->wheel_position_in_set = 0;  // Start at first function in new set
+            } else if (final_click_count >= 3) {
+                // Triple-click: toggle to/from Set 2
+                if (kp->wheel_current_set == 2) {
+                    // From Set 2, go back to Set 0
+                    kp->wheel_current_set = 0;
+                } else {
+                    // From Set 0 or 1, go to Set 2
+                    kp->wheel_current_set = 2;
+                }
+                kp->wheel_position_in_set = 0;  // Start at first function in new set
+            }
+
+            // Calculate actual wheel function index
+            // Note: wheelFunction may be >= totalWheels if incomplete sets exist
+            // That's OK - wheel turn handler checks bounds before executing
+            kp->wheelFunction = (kp->wheel_current_set * 2) + kp->wheel_position_in_set;
+
+            if (d->debug == 1) {
+                printf("Set: %d | Position: %d | Wheel Function: %d\n",
+                       kp->wheel_current_set, kp->wheel_position_in_set, kp->wheelFunction);
+                if (kp->wheelFunction >= 0 && kp->wheelFunction < d->config->totalWheels) {
+                    printf("Function: %s | %s\n",
+                           d->config->wheelEvents[kp->wheelFunction].left ? d->config->wheelEvents[kp->wheelFunction].left : "(null)",
+                           d->config->wheelEvents[kp->wheelFunction].right ? d->config->wheelEvents[kp->wheelFunction].right : "(null)");
+                } else {
+                    printf("Function: (not defined - incomplete set)\n");
+                }
+            }
+
+            // Update OSD wheel state
+            if (d->osd) {
+                osd_set_wheel_state(d->osd, kp->wheel_current_set, kp->wheel_position_in_set,
+                                     kp->wheelFunction, 1, d->config->totalWheels);
+
+                // Record set change as an action with description
+                const char* set_desc = NULL;
+                if (kp->wheelFunction >= 0 && kp->wheelFunction < d->config->totalWheels &&
+                    d->config->wheelEvents[kp->wheelFunction].description) {
+                    set_desc = d->config->wheelEvents[kp->wheelFunction].description;
+                }
+                char set_action[128];
+                if (set_desc) {
+                    snprintf(set_action, sizeof(set_action), "Set %d: %s",
+                             kp->wheel_current_set + 1, set_desc);
+                } else {
+                    snprintf(set_action, sizeof(set_action), "Set %d",
+                             kp->wheel_current_set + 1);
+                }
+                osd_record_action(d->osd, 18, set_action);
+            }
+        }
+    }
+}
+
+// Arm the leader timeout for the current leader press or sequence step
+// (toggle mode has none between sequences)
+static void update_leader_timer(keypad_t* kp) {
+    leader_state* leader = &kp->leader;
+    if ((leader->leader_active && leader->mode != LEADER_MODE_TOGGLE) || leader->sequence_node != 0) {
+        long remaining = leader->timeout_ms - (get_time_ms() - leader->leader_press_ms);
+        reactor_timer_arm(kp->leader_timer, remaining, 0);
+    } else {
+        reactor_timer_disarm(kp->leader_timer);
+    }
+}
+
+// Show the leader state and the sequence continuations on the OSD
+static void update_leader_osd(keypad_t* kp) {
+    dispatcher_t* d = kp->dispatcher;
+    if (d->osd == NULL) return;
+
+    leader_state* leader = &kp->leader;
+    int active = leader->leader_active || leader->toggle_state;
+    const leader_node_t* node = active ? leader_sequence_node(leader, kp->config->leader_trie) : NULL;
+    osd_set_leader_hint(d->osd, leader->sequence_node != 0,
+                        node ? node->next_mask : 0, node ? node->hint : NULL);
+    osd_set_leader_state(d->osd, active, leader->leader_button);
+}
+
+// Leader timeout expired: drop back to normal mode right away instead of
+// waiting for the next button press to notice
+static void on_leader_timeout(void* user_data) {
+    keypad_t* kp = (keypad_t*)user_data;
+    dispatcher_t* d = kp->dispatcher;
+    leader_state* leader = &kp->leader;
+
+    // A profile switch drops a sequence in progress
+    keypad_refresh_config(kp);
+    if (leader->sequence_node != 0) {
+        // Waited for a step that didn't come
+        leader_sequence_expire(leader, kp->config->leader_trie, d->debug);
+        update_leader_timer(kp);
+        update_leader_osd(kp);
+        return;
+    }
+    if (!leader->leader_active || leader->mode == LEADER_MODE_TOGGLE) {
+        return;
+    }
+    if (d->debug == 1) {
+        printf("Leader timeout (%d ms)\n", leader->timeout_ms);
+    }
+    reset_leader_state(leader);
+    leader->toggle_state = 0;
+    update_leader_osd(kp);
+}
+
+// Button 18 click window closed
+static void on_click_timeout(void* user_data) {
+    keypad_t* kp = (keypad_t*)user_data;
+    keypad_refresh_config(kp);
+    process_pending_clicks(kp, 1);
+}
+
+// Send count wheel ticks of one function and direction as one injection
+static void emit_wheel(keypad_t* kp, int function, int direction, int count) {
+    dispatcher_t* d = kp->dispatcher;
+
+    if (function < 0 || function >= d->config->totalWheels) {
+        return;
+    }
+    const action_t* action = direction > 0 ? d->config->wheelEvents[function].right_action
+                                           : d->config->wheelEvents[function].left_action;
+    if (action == NULL) {
+        return;
+    }
+
+    if (d->debug == 1 && count > 1) {
+        printf("Keypad %d: %d wheel ticks coalesced\n", kp->id, count);
+    }
+    handler_action_repeat(action, count, d->debug);
+
+    // Record aggregated wheel action to OSD
+    if (d->osd) {
+        const char* desc = d->config->wheelEvents[function].description;
+        osd_record_wheel_action(d->osd, direction > 0 ? "increase" : "decrease", desc, count);
+    }
+}
+
+// Send the ticks collected in the current window.
+// close: end the window too, so the next tick is sent at once.
+static void flush_wheel(keypad_t* kp, int close) {
+    if (kp->wheel_pending > 0) {
+        emit_wheel(kp, kp->wheel_pending_function, kp->wheel_pending_direction, kp->wheel_pending);
+        kp->wheel_pending = 0;
+    }
+    if (close && kp->wheel_window_open) {
+        kp->wheel_window_open = 0;
+        reactor_timer_disarm(kp->wheel_timer);
+    }
+}
+
+// Wheel tick. The first tick of a spin is sent immediately; the ones
+// that follow within wheel_coalesce_ms are batched into a single key
+// press with a repeat count, so a fast spin costs one injection per
+// window instead of one per tick.
+static void wheel_tick(keypad_t* kp, int direction) {
+    dispatcher_t* d = kp->dispatcher;
+    int window = d->config->wheel_coalesce_ms;
+
+    if (window <= 0 || kp->wheel_timer == NULL) {
+        emit_wheel(kp, kp->wheelFunction, direction, 1);
+        return;
+    }
+
+    if (!kp->wheel_window_open) {
+        emit_wheel(kp, kp->wheelFunction, direction, 1);
+        kp->wheel_window_open = 1;
+        reactor_timer_arm(kp->wheel_timer, window, 0);
+        return;
+    }
+
+    // A direction or function change can't share a repeat count
+    if (kp->wheel_pending > 0 &&
+        (direction != kp->wheel_pending_direction || kp->wheelFunction != kp->wheel_pending_function)) {
+        flush_wheel(kp, 0);
+    }
+    kp->wheel_pending++;
+    kp->wheel_pending_direction = direction;
+    kp->wheel_pending_function = kp->wheelFunction;
+}
+
+// Coalescing window elapsed: send its ticks and keep the window open
+// while the wheel is still turning
+static void on_wheel_timeout(void* user_data) {
+    keypad_t* kp = (keypad_t*)user_data;
+    keypad_refresh_config(kp);
+
+    if (kp->wheel_pending > 0) {
+        flush_wheel(kp, 0);
+        reactor_timer_arm(kp->wheel_timer, kp->dispatcher->config->wheel_coalesce_ms, 0);
+    } else {
+        kp->wheel_window_open = 0;
+    }
+}
+
+// Autorepeat of a held button
+static void on_repeat(void* user_data) {
+    keypad_t* kp = (keypad_t*)user_data;
+    keypad_refresh_config(kp);
+
+    if (kp->repeat_action) {
+        handler_press(kp->repeat_action, kp->dispatcher->debug);
+    }
+}
+
+// Repeat the action while the button is down. The config is referenced,
+// so a profile switch meanwhile can't free the action.
+static void start_repeat(keypad_t* kp, int button, const action_t* action) {
+    config_t* config = kp->config;
+
+    kp->repeat_action = action;
+    kp->repeat_config = config_ref(config);
+    kp->repeat_button = button;
+    reactor_timer_arm(kp->repeat_timer, config->repeat_delay_ms, 1000 / config->repeat_rate);
+}
+
+static void stop_repeat(keypad_t* kp) {
+    if (kp->repeat_action == NULL) return;
+    reactor_timer_disarm(kp->repeat_timer);
+    // The last repeat may still be held down by the handler
+    handler_release_held();
+    kp->repeat_action = NULL;
+    config_destroy(kp->repeat_config);
+    kp->repeat_config = NULL;
+}
+
+// A button came up: end its autorepeat and release what it holds down
+static void button_released(keypad_t* kp, int button) {
+    dispatcher_t* d = kp->dispatcher;
+
+    if (d->debug == 1) {
+        printf("Keypad %d: Button %d released\n", kp->id, button);
+    }
+    if (kp->repeat_action && kp->repeat_button == button) {
+        stop_repeat(kp);
+    }
+    if (kp->held_keys[button]) {
+        handler_action(kp->held_keys[button], 1, d->debug);
+        kp->held_keys[button] = NULL;
+        config_destroy(kp->held_configs[button]);
+        kp->held_configs[button] = NULL;
+    }
+    if (kp->held_mouse[button]) {
+        handler_mouse(kp->held_mouse[button], 0, d->debug);
+        kp->held_mouse[button] = 0;
+    }
+}
+
+// Button 18 "swap": next wheel function, or a click of a multi-click set
+static void wheel_swap(keypad_t* kp) {
+    dispatcher_t* d = kp->dispatcher;
+
+    // Check wheel mode
+    if (d->config->wheel_mode == WHEEL_MODE_SEQUENTIAL) {
+        // Sequential mode: simple cycling through all functions
+        if (kp->wheelFunction != d->config->totalWheels - 1) {
+            kp->wheelFunction++;
+        } else {
+            kp->wheelFunction = 0;
+        }
+        if (d->debug == 1) {
+            printf("Sequential mode - Wheel Function: %d\n", kp->wheelFunction);
+            printf("Function: %s | %s\n",
+                   d->config->wheelEvents[kp->wheelFunction].left ? d->config->wheelEvents[kp->wheelFunction].left : "(null)",
+                   d->config->wheelEvents[kp->wheelFunction].right ? d->config->wheelEvents[kp->wheelFunction].right : "(null)");
+        }
+        // Update OSD
+        if (d->osd) {
+            osd_set_wheel_state(d->osd, 0, 0, kp->wheelFunction, 0, d->config->totalWheels);
+            const char* desc = (kp->wheelFunction >= 0 && kp->wheelFunction < d->config->totalWheels) ?
+                                d->config->wheelEvents[kp->wheelFunction].description : NULL;
+            char seq_action[128];
+            if (desc) {
+                snprintf(seq_action, sizeof(seq_action), "Swap to: %s", desc);
+            } else {
+                snprintf(seq_action, sizeof(seq_action), "Swap to: Fn %d", kp->wheelFunction);
+            }
+            osd_record_action(d->osd, 18, seq_action);
+        }
+    } else {
+        // Sets mode: multi-click detection for set-based navigation
+        // Just record the click - processing happens once the click timeout expires
+        long now = get_time_ms();
+
+        long time_since_last_click = 0;
+        if (kp->last_button18_ms != 0) {
+            time_since_last_click = now - kp->last_button18_ms;
+        }
+
+        // If click is within timeout window, increment count
+        if (time_since_last_click > 0 && time_since_last_click < d->config->wheel_click_timeout_ms) {
+            kp->button18_click_count++;
+            if (d->debug == 1) {
+                printf("Button 18 click recorded (count now: %d)\n", kp->button18_click_count);
+            }
+        } else {
+            // This is a new click sequence
+            kp->button18_click_count = 1;
+            if (d->debug == 1) {
+                printf("Button 18 new click sequence started\n");
+            }
+        }
+
+        kp->last_button18_ms = now;
+        // Don't process yet - wait for the click window to close
+        reactor_timer_arm(kp->click_timer, d->config->wheel_click_timeout_ms, 0);
+    }
+}
+
+// A button went down
+static void button_pressed(keypad_t* kp, int button_index) {
+    dispatcher_t* d = kp->dispatcher;
+
+    if (d->debug == 1) {
+        printf("Keypad %d: Button %d\n", kp->id, button_index);
+    }
+
+    // A new press ends the autorepeat of the previous one
+    stop_repeat(kp);
+
+    // Check for OSD toggle button
+    if (d->config->osd.enabled && button_index == d->config->osd.osd_toggle_button && d->osd) {
+        osd_toggle_mode(d->osd);
+        if (d->debug) {
+            printf("OSD mode toggled\n");
+        }
+    }
+
+    // Set active button highlight on OSD
+    if (d->osd) {
+        osd_set_active_button(d->osd, button_index);
+    }
+
+    const action_t* action = button_index < kp->config->totalButtons ?
+                             kp->config->events[button_index].action : NULL;
+
+    // Record action to OSD
+    if (d->osd && action && action->kind != ACTION_NONE) {
+        osd_record_action(d->osd, button_index, action->text);
+    }
+
+    // A button press stops a running macro (its own button stops it in macro_play)
+    if (action == NULL || action->kind != ACTION_MACRO) {
+        macro_cancel();
+    }
+
+    // Process button press with leader system
+    int own_keys = process_leader_combination(&kp->leader, kp->config->leader_trie,
+                                              kp->config->events, button_index, d->debug);
+    latency_mark(LAT_STAGE_LEADER);
+    update_leader_timer(kp);
+
+    // Keys pressed as the button's own function may stay down or repeat
+    if (own_keys) {
+        hold_mode_t mode = kp->config->events[button_index].hold_mode;
+        if (mode == HOLD_MODE_HOLD) {
+            // Released with the button, maybe after a profile switch
+            kp->held_keys[button_index] = action;
+            kp->held_configs[button_index] = config_ref(kp->config);
+        } else if (mode == HOLD_MODE_REPEAT) {
+            start_repeat(kp, button_index, action);
+        }
+    }
+
+    // Update leader state on OSD
+    update_leader_osd(kp);
+
+    // Also handle legacy single-button events for compatibility
+    if (action == NULL) return;
+    switch (action->kind) {
+        case ACTION_NONE:
+            if (kp->held_mouse_button != 0) {
+                handler_mouse(kp->held_mouse_button, 0, d->debug);
+                kp->held_mouse_button = 0;
+            }
+            break;
+        case ACTION_SWAP:
+            wheel_swap(kp);
+            break;
+        case ACTION_PLUGIN: {
+            profile_t* active = d->profile_manager ? profile_manager_get_active(d->profile_manager) : NULL;
+            const char* profile = kp->bound_profile ? kp->bound_profile : active ? active->name : NULL;
+            handler_plugin(action, button_index, kp->id, profile, d->debug);
+            break;
+        }
+        case ACTION_MOUSE:
+            if (kp->config->events[button_index].hold_mode == HOLD_MODE_HOLD) {
+                // Held with the button
+                handler_mouse(action->mouse_button, 1, d->debug);
+                kp->held_mouse[button_index] = (unsigned char)action->mouse_button;
+                break;
+            }
+            if (action->mouse_button != kp->held_mouse_button) {
+                if (kp->held_mouse_button != 0) {
+                    handler_mouse(kp->held_mouse_button, 0, d->debug);
+                }
+                kp->held_mouse_button = action->mouse_button;
+            }
+            handler_mouse(action->mouse_button, 1, d->debug);
+            break;
+        default:
+            // Keys, programs, macros and the leader went through the leader system
+            break;
+    }
+}
+
+// Handle the held back presses one by one, in the order they came
+static void flush_chord(keypad_t* kp) {
+    reactor_timer_disarm(kp->chord_timer);
+    kp->chord_pending = 0;
+
+    int count = kp->chord_order_count;
+    kp->chord_order_count = 0;
+    for (int i = 0; i < count; i++) {
+        button_pressed(kp, kp->chord_order[i]);
+    }
+}
+
+// Send the chord the held back presses form, or handle them one by one
+static void resolve_chord(keypad_t* kp) {
+    dispatcher_t* d = kp->dispatcher;
+    if (kp->chord_pending == 0) return;
+
+    unsigned int pending = kp->chord_pending;
+    const chord_t* chord = chord_find(kp->config->chord_table, pending);
+    if (chord == NULL) {
+        flush_chord(kp);
+        return;
+    }
+    reactor_timer_disarm(kp->chord_timer);
+    kp->chord_pending = 0;
+    kp->chord_order_count = 0;
+
+    if (d->debug == 1) {
+        printf("Keypad %d: Chord %s\n", kp->id, chord->action->text);
+    }
+    macro_cancel();
+    if (d->osd) {
+        osd_record_action(d->osd, kp->chord_order[0], chord->action->text);
+    }
+    handler_action(chord->action, -1, d->debug);
+    // Their releases don't belong to single presses
+    kp->chord_consumed |= pending;
+}
+
+static void on_chord_timeout(void* user_data) {
+    keypad_t* kp = (keypad_t*)user_data;
+    keypad_refresh_config(kp);
+    resolve_chord(kp);
+}
+
+// A button went down: hold it back if it may be part of a chord
+static void chord_press(keypad_t* kp, int button) {
+    dispatcher_t* d = kp->dispatcher;
+    const chord_table_t* table = kp->config->chord_table;
+    unsigned int bit = 1u << button;
+
+    if (table == NULL || !(table->members & bit)) {
+        resolve_chord(kp);
+        button_pressed(kp, button);
+        return;
+    }
+
+    if (kp->chord_pending == 0) {
+        kp->chord_start_ms = get_time_ms();
+        reactor_timer_arm(kp->chord_timer, kp->config->chord_window_ms, 0);
+    }
+    kp->chord_pending |= bit;
+    kp->chord_order[kp->chord_order_count++] = (unsigned char)button;
+    if (d->debug == 1) {
+        printf("Keypad %d: Button %d (chord?)\n", kp->id, button);
+    }
+
+    // Nothing longer to wait for
+    if (!chord_extends(table, kp->chord_pending)) {
+        resolve_chord(kp);
+    }
+}
+
+// A button came up, after tap-hold decisions
+static void chord_release(keypad_t* kp, int button) {
+    unsigned int bit = 1u << button;
+
+    if (kp->chord_pending & bit) {
+        resolve_chord(kp);
+    }
+    if (kp->chord_consumed & bit) {
+        kp->chord_consumed &= ~bit;
+        return;
+    }
+    button_released(kp, button);
+}
+
+static void edge_press(keypad_t* kp, int button);
+static void edge_release(keypad_t* kp, int button);
+
+// Settle the undecided tap-hold button, then pass on the edges that came
+// while it was undecided
+static void tap_hold_decide(keypad_t* kp, int hold) {
+    dispatcher_t* d = kp->dispatcher;
+    int button = kp->tap_hold_button;
+    if (button < 0) return;
+
+    reactor_timer_disarm(kp->tap_hold_timer);
+    kp->tap_hold_button = -1;
+    const action_t* hold_action = kp->tap_hold_action;
+    config_t* hold_config = kp->tap_hold_config;
+    kp->tap_hold_action = NULL;
+    kp->tap_hold_config = NULL;
+    unsigned char queue[TAP_HOLD_QUEUE];
+    int queued = kp->tap_hold_queued;
+    memcpy(queue, kp->tap_hold_queue, queued);
+    kp->tap_hold_queued = 0;
+
+    if (hold) {
+        if (d->debug == 1) {
+            printf("Keypad %d: Button %d held: %s\n", kp->id, button, hold_action->text);
+        }
+        macro_cancel();
+        if (hold_action->kind == ACTION_MOUSE) {
+            handler_mouse(hold_action->mouse_button, 1, d->debug);
+            kp->held_mouse[button] = (unsigned char)hold_action->mouse_button;
+            config_destroy(hold_config);
+        } else {
+            // Its config reference goes with it
+            handler_action(hold_action, 0, d->debug);
+            kp->held_keys[button] = hold_action;
+            kp->held_configs[button] = hold_config;
+        }
+    } else {
+        if (d->debug == 1) {
+            printf("Keypad %d: Button %d tapped\n", kp->id, button);
+        }
+        config_destroy(hold_config);
+        chord_press(kp, button);
+    }
+
+    for (int i = 0; i < queued; i++) {
+        if (queue[i] & 0x80) {
+            edge_press(kp, queue[i] & 0x7f);
+        } else {
+            edge_release(kp, queue[i]);
+        }
+    }
+}
+
+static void on_tap_hold_timeout(void* user_data) {
+    keypad_t* kp = (keypad_t*)user_data;
+    keypad_refresh_config(kp);
+    tap_hold_decide(kp, 1);
+}
+
+// Keep an edge back until the tap-hold button is decided. Returns 0 if the
+// queue is full.
+static int tap_hold_queue(keypad_t* kp, int button, int pressed) {
+    if (kp->tap_hold_queued == TAP_HOLD_QUEUE) return 0;
+    kp->tap_hold_queue[kp->tap_hold_queued++] = (unsigned char)(button | (pressed ? 0x80 : 0));
+    return 1;
+}
+
+// Press edge from the report bitmap
+static void edge_press(keypad_t* kp, int button) {
+    dispatcher_t* d = kp->dispatcher;
+
+    if (kp->tap_hold_button >= 0) {
+        if (!tap_hold_queue(kp, button, 1)) {
+            tap_hold_decide(kp, 1);
+            edge_press(kp, button);
+        } else if (kp->tap_hold_mode == TAP_HOLD_INTERRUPT) {
+            tap_hold_decide(kp, 1);
+        }
+        return;
+    }
+
+    const event* ev = button < kp->config->totalButtons ? &kp->config->events[button] : NULL;
+    if (button != 18 && ev && ev->hold_action) {
+        // The config may change before the decision: keep it until then
+        kp->tap_hold_action = ev->hold_action;
+        kp->tap_hold_config = config_ref(kp->config);
+        kp->tap_hold_button = button;
+        kp->tap_hold_start_ms = get_time_ms();
+        kp->tap_hold_threshold_ms = ev->hold_threshold_ms;
+        kp->tap_hold_mode = ev->tap_hold_mode;
+        reactor_timer_arm(kp->tap_hold_timer, kp->tap_hold_threshold_ms, 0);
+        if (d->debug == 1) {
+            printf("Keypad %d: Button %d (tap or hold?)\n", kp->id, button);
+        }
+        return;
+    }
+    chord_press(kp, button);
+}
+
+// Release edge from the report bitmap
+static void edge_release(keypad_t* kp, int button) {
+    if (kp->tap_hold_button == button) {
+        // Released before the threshold
+        tap_hold_decide(kp, 0);
+        chord_release(kp, button);
+        return;
+    }
+
+    if (kp->tap_hold_button >= 0) {
+        int pressed_meanwhile = 0;
+        for (int i = 0; i < kp->tap_hold_queued; i++) {
+            if (kp->tap_hold_queue[i] == (button | 0x80)) pressed_meanwhile = 1;
+        }
+        if (!tap_hold_queue(kp, button, 0)) {
+            tap_hold_decide(kp, 1);
+            edge_release(kp, button);
+        } else if (pressed_meanwhile && kp->tap_hold_mode == TAP_HOLD_PERMISSIVE) {
+            tap_hold_decide(kp, 1);
+        }
+        return;
+    }
+    chord_release(kp, button);
+}
+
+// Re-resolve the keypad's config after a profile switch or reload. Runs
+// before anything reads kp->config: on every report and timer, and from the
+// profile manager before it frees the configs that went stale.
+static void keypad_refresh_config(keypad_t* kp) {
+    dispatcher_t* d = kp->dispatcher;
+    profile_manager_t* pm = d->profile_manager;
+
+    if (kp->config != NULL && (pm == NULL || kp->config_generation == pm->generation)) {
+        return;
+    }
+
+    config_t* config = NULL;
+    if (pm) {
+        if (kp->bound_profile) {
+            config = profile_manager_get_profile_config(pm, kp->bound_profile);
+            if (config == NULL && d->debug) {
+                printf("Keypad %d: profile '%s' not loaded, following active window\n",
+                       kp->id, kp->bound_profile);
+            }
+        }
+        if (config == NULL) {
+            config = profile_manager_get_config(pm);
+        }
+        kp->config_generation = pm->generation;
+    }
+    config = config ? config : d->config;
+    if (config == kp->config) {
+        return;
+    }
+    kp->config = config;
+
+    if (kp->leader.sequence_node != 0) {
+        // The sequence so far belongs to the old trie
+        kp->leader.sequence_node = 0;
+        update_leader_timer(kp);
+        update_leader_osd(kp);
+    }
+    if (kp->chord_pending) {
+        // Held back for a chord table that is gone
+        flush_chord(kp);
+    }
+}
+
+// Profile switch or reload: move every keypad off the stale configs
+static void on_config_change(void* user_data) {
+    dispatcher_t* d = (dispatcher_t*)user_data;
+
+    // A key the handler holds down may belong to one of them
+    handler_release_held();
+
+    for (int i = 0; i < MAX_KEYPADS; i++) {
+        if (d->keypads[i].in_use) {
+            keypad_refresh_config(&d->keypads[i]);
+        }
+    }
+}
+
+// Decode and dispatch one input report. Used as the transfer engine's
+// completion callback, so it runs as soon as the report arrives.
+void dispatcher_report(const unsigned char* data, int length, void* user_data) {
+    keypad_t* kp = (keypad_t*)user_data;
+    dispatcher_t* d = kp->dispatcher;
+
+    if (d->capture) {
+        capture_write(d->capture, kp->id, data, length);
+    }
+
+    if (length < DECODE_MIN_LENGTH) {
+        return;
+    }
+
+    latency_begin();
+    keypad_refresh_config(kp);
+
+    // Resolve a click sequence that timed out before this report arrived
+    process_pending_clicks(kp, 0);
+
+    // Table lookup: report bytes -> button index or wheel direction
+    decoded_report_t report;
+    decode_report(data, length, &report);
+    latency_mark(LAT_STAGE_DECODE);
+    if (d->dry)
+        report.kind = DECODE_NONE;
+
+    if (d->debug == 1 && report.kind == DECODE_WHEEL) {
+        printf("Keypad %d: Wheel %s\n", kp->id, report.direction > 0 ? "clockwise" : "counter-clockwise");
+    }
+
+    // Handle wheel events
+    if (report.kind == DECODE_WHEEL) {
+        wheel_tick(kp, report.direction);
+    } else {
+        // Ticks collected so far happened before this report
+        flush_wheel(kp, 1);
+
+        // Press and release edges from the button bitmap
+        if (report.has_buttons && !d->dry) {
+            unsigned int released = kp->buttons_down & ~report.mask;
+            unsigned int pressed = report.mask & ~kp->buttons_down;
+
+            // A hold threshold or chord window that passed before this
+            // report (their timers may not have run yet)
+            if (kp->tap_hold_button >= 0 &&
+                get_time_ms() - kp->tap_hold_start_ms >= kp->tap_hold_threshold_ms) {
+                tap_hold_decide(kp, 1);
+            }
+            if (kp->chord_pending &&
+                get_time_ms() - kp->chord_start_ms >= kp->config->chord_window_ms) {
+                resolve_chord(kp);
+            }
+            kp->buttons_down = report.mask;
+
+            for (int b = 0; b < DECODE_BUTTON_COUNT; b++) {
+                if (released & (1u << b)) edge_release(kp, b);
+            }
+            for (int b = 0; b < DECODE_BUTTON_COUNT; b++) {
+                if (pressed & (1u << b)) edge_press(kp, b);
+            }
+        }
+    }
+
+    if (d->debug == 2 || d->dry) {
+        printf("DATA: [%d", data[0]);
+        for (int i = 1; i < length; i++) {
+            printf(", %d", data[i]);
+        }
+        printf("]\n");
+
+        if (kp->leader.toggle_state) {
+            printf("Leader toggle: ON (mode: %s)\n", leader_mode_to_string(kp->leader.mode));
+        } else if (kp->leader.leader_active) {
+            long elapsed = get_time_ms() - kp->leader.leader_press_ms;
+            printf("Leader active: YES (%ld ms elapsed, mode: %s)\n",
+                   elapsed, leader_mode_to_string(kp->leader.mode));
+        } else {
+            printf("Leader active: NO\n");
+        }
+    }
+
+    latency_end();
+}
+
+dispatcher_t* dispatcher_create(config_t* config, osd_state_t* osd, profile_manager_t* profile_manager,
+                                reactor_t* reactor, int debug, int dry) {
+    if (config == NULL || reactor == NULL) return NULL;
+
+    dispatcher_t* d = calloc(1, sizeof(dispatcher_t));
+    if (d == NULL) return NULL;
+
+    d->config = config;
+    d->osd = osd;
+    d->profile_manager = profile_manager;
+    d->reactor = reactor;
+    d->debug = debug;
+    d->dry = dry;
+    if (profile_manager) {
+        profile_manager_set_change_callback(profile_manager, on_config_change, d);
+    }
+
+    decode_init();
+    return d;
+}
+
+void dispatcher_destroy(dispatcher_t* d) {
+    if (d == NULL) return;
+
+    if (d->profile_manager) {
+        profile_manager_set_change_callback(d->profile_manager, NULL, NULL);
+    }
+    for (int i = 0; i < MAX_KEYPADS; i++) {
+        if (d->keypads[i].in_use) {
+            dispatcher_detach(d, &d->keypads[i]);
+        }
+    }
+    free(d);
+}
+
+keypad_t* dispatcher_attach(dispatcher_t* d, const char* port) {
+    if (d == NULL) return NULL;
+
+    keypad_t* kp = NULL;
+    for (int i = 0; i < MAX_KEYPADS; i++) {
+        if (!d->keypads[i].in_use) {
+            kp = &d->keypads[i];
+            memset(kp, 0, sizeof(keypad_t));
+            kp->id = i;
+            break;
+        }
+    }
+    if (kp == NULL) {
+        printf("Too many keypads (max %d), ignoring device\n", MAX_KEYPADS);
+        return NULL;
+    }
+
+    kp->dispatcher = d;
+    kp->in_use = 1;
+    if (port) {
+        snprintf(kp->port, sizeof(kp->port), "%s", port);
+        if (d->capture) {
+            capture_write_attach(d->capture, kp->id, port);
+        }
+    }
+
+    // Leader settings are shared, the runtime state is per keypad
+    kp->leader = d->config->leader;
+    reset_leader_state(&kp->leader);
+    kp->leader.toggle_state = 0;
+
+    kp->leader_timer = reactor_timer_create(d->reactor, on_leader_timeout, kp);
+    kp->click_timer = reactor_timer_create(d->reactor, on_click_timeout, kp);
+    kp->wheel_timer = reactor_timer_create(d->reactor, on_wheel_timeout, kp);
+    kp->repeat_timer = reactor_timer_create(d->reactor, on_repeat, kp);
+    kp->chord_timer = reactor_timer_create(d->reactor, on_chord_timeout, kp);
+    kp->tap_hold_timer = reactor_timer_create(d->reactor, on_tap_hold_timeout, kp);
+    kp->tap_hold_button = -1;
+
+    // device_profile binding by USB port
+    for (int i = 0; i < d->config->device_binding_count; i++) {
+        if (port && strcmp(port, d->config->device_bindings[i].port) == 0) {
+            kp->bound_profile = d->config->device_bindings[i].profile;
+            printf("Keypad %d (port %s) bound to profile '%s'\n", kp->id, port, kp->bound_profile);
+            break;
+        }
+    }
+
+    d->keypad_count++;
+    keypad_refresh_config(kp);
+    return kp;
+}
+
+void dispatcher_detach(dispatcher_t* d, keypad_t* kp) {
+    if (d == NULL || kp == NULL || !kp->in_use) return;
+
+    keypad_refresh_config(kp);
+    flush_wheel(kp, 1);
+
+    // Presses still held back are sent, not lost: an undecided tap-hold
+    // button counts as released before its threshold, a chord window
+    // closes now
+    while (kp->tap_hold_button >= 0) {
+        tap_hold_decide(kp, 0);
+    }
+    resolve_chord(kp);
+
+    // Don't leave keys or mouse buttons held down
+    stop_repeat(kp);
+    for (int b = 0; b < DECODE_BUTTON_COUNT; b++) {
+        if (kp->held_keys[b] || kp->held_mouse[b]) button_released(kp, b);
+    }
+    kp->buttons_down = 0;
+    kp->chord_consumed = 0;
+    if (kp->held_mouse_button != 0) {
+        handler_mouse(kp->held_mouse_button, 0, d->debug);
+        kp->held_mouse_button = 0;
+    }
+
+    reactor_timer_destroy(kp->leader_timer);
+    reactor_timer_destroy(kp->click_timer);
+    reactor_timer_destroy(kp->wheel_timer);
+    reactor_timer_destroy(kp->repeat_timer);
+    reactor_timer_destroy(kp->chord_timer);
+    reactor_timer_destroy(kp->tap_hold_timer);
+    kp->repeat_timer = NULL;
+    kp->chord_timer = NULL;
+    kp->tap_hold_timer = NULL;
+    kp->leader_timer = NULL;
+    kp->click_timer = NULL;
+    kp->wheel_timer = NULL;
+    kp->in_use = 0;
+    d->keypad_count--;
+}
@@ -0,0 +1,121 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "config.h"
+#include "leader.h"
+#include "osd.h"
+#include "profiles.h"
+#include "reactor.h"
+#include "capture.h"
+#include "decode.h"
+
+// ============================================================================
+// DISPATCHER
+// ============================================================================
+//
+// Turns decoded input reports into actions. State that belongs to one
+// physical keypad (leader, wheel set, click detection, profile binding)
+// lives in a keypad_t slot, so several keypads can be driven at once
+// without interfering. Reports carry their keypad, so dispatch never
+// searches the slot table.
+//
+// ============================================================================
+
+// Maximum number of keypads driven concurrently
+#define MAX_KEYPADS 8
+
+// Button edges kept back while a tap-hold button is undecided
+#define TAP_HOLD_QUEUE 32
+
+typedef struct dispatcher dispatcher_t;
+
+// Per-keypad state
+typedef struct {
+    dispatcher_t* dispatcher;
+    int in_use;
+    int id;                        // Slot number, shown in debug output
+    char port[32];                 // USB port path ("1-4.2"), empty if unknown
+
+    // Configuration in use: a bound profile, or the active window's profile
+    config_t* config;
+    const char* bound_profile;     // device_profile binding (NULL = follow window)
+    unsigned int config_generation;
+
+    leader_state leader;           // Leader state (settings copied from config)
+    int held_mouse_button;         // Mouse button held down (0 = none)
+
+    // Button state from the report bitmaps (press/release edges)
+    unsigned int buttons_down;     // Bit n = button n is down
+    const action_t* held_keys[DECODE_BUTTON_COUNT];  // hold_mode hold: keys to release
+    config_t* held_configs[DECODE_BUTTON_COUNT];     // Their configs, referenced until then
+    unsigned char held_mouse[DECODE_BUTTON_COUNT];   // hold_mode hold: mouse button to release
+    const action_t* repeat_action; // hold_mode repeat: keys repeating (NULL = none)
+    config_t* repeat_config;       // Its config, referenced while repeating
+    int repeat_button;
+
+    // Chord recognition (see chord.h)
+    unsigned int chord_pending;    // Chord buttons down, their presses held back
+    unsigned char chord_order[DECODE_BUTTON_COUNT];  // Held back presses in order
+    int chord_order_count;
+    long chord_start_ms;           // First held back press (get_time_ms)
+    unsigned int chord_consumed;   // Buttons of a sent chord, until released
+
+    // Tap-hold decision (hold_function buttons), settings taken at the press
+    int tap_hold_button;           // Button not yet known as tap or hold (-1 = none)
+    long tap_hold_start_ms;        // Its press (get_time_ms)
+    const action_t* tap_hold_action;  // Its hold_function
+    config_t* tap_hold_config;     // Config of the press, referenced until decided
+    int tap_hold_threshold_ms;
+    tap_hold_mode_t tap_hold_mode;
+    unsigned char tap_hold_queue[TAP_HOLD_QUEUE];  // Later edges: button, | 0x80 = press
+    int tap_hold_queued;
+
+    int wheelFunction;
+
+    // Multi-click detection state for button 18
+    long last_button18_ms;         // get_time_ms of the last click (0 = none)
+    int button18_click_count;
+    int wheel_current_set;         // Current set: 0 (functions 0-1), 1 (functions 2-3), 2 (functions 4-5)
+    int wheel_position_in_set;     // Position within set: 0 or 1
+
+    // Wheel tick coalescing
+    int wheel_window_open;         // Ticks are being batched
+    int wheel_pending;             // Ticks collected in the current window
+    int wheel_pending_direction;
+    int wheel_pending_function;
+
+    reactor_timer_t* leader_timer; // Leader timeout
+    reactor_timer_t* click_timer;  // Button 18 multi-click window
+    reactor_timer_t* wheel_timer;  // Wheel coalescing window
+    reactor_timer_t* repeat_timer; // Autorepeat of a held button
+    reactor_timer_t* chord_timer;  // Chord window
+    reactor_timer_t* tap_hold_timer;  // Hold threshold
+} keypad_t;
+
+// Shared dispatcher state
+struct dispatcher {
+    config_t* config;              // Base configuration
+    osd_state_t* osd;              // Shared OSD (NULL if disabled)
+    profile_manager_t* profile_manager;
+    reactor_t* reactor;
+    int debug;
+    int dry;
+    capture_t* capture;            // Raw report capture (NULL = off)
+    keypad_t keypads[MAX_KEYPADS];
+    int keypad_count;
+};
+
+// Lifecycle functions
+dispatcher_t* dispatcher_create(config_t* config, osd_state_t* osd, profile_manager_t* profile_manager,
+                                reactor_t* reactor, int debug, int dry);
+void dispatcher_destroy(dispatcher_t* dispatcher);
+
+// Claim a keypad slot for a newly attached device (port may be NULL)
+keypad_t* dispatcher_attach(dispatcher_t* dispatcher, const char* port);
+void dispatcher_detach(dispatcher_t* dispatcher, keypad_t* keypad);
+
+// Decode and dispatch one report; user_data is the keypad_t*.
+// Matches transfer_report_cb so it can be handed to the transfer engine.
+void dispatcher_report(const unsigned char* data, int length, void* user_data);
+
+#endif // DISPATCH_H
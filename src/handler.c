@@ -1,65 +1,292 @@
 #include "handler.h"
+#include "latency.h"
+#include "xtest.h"
+#include "uinput.h"
+#include "xdotool.h"
+#include "macro.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-void Handler(char* key, int type, int debug) {
-    if (key == NULL) {
-        if (debug == 1) printf("Handler called with NULL key\n");
+static handler_sink_t handler_sink = HANDLER_SINK_REAL;
+static long handler_count = 0;
+static injection_backend_t handler_backend = INJECTION_XDOTOOL;
+
+// Key held by handler_press() (NULL = none)
+static struct {
+    const action_t* action;
+    int debug;
+} held_key;
+static reactor_timer_t* release_timer = NULL;
+static int key_hold_ms = 10;
+
+static void release_held_key(void);
+
+injection_backend_t handler_init(injection_backend_t backend, int debug) {
+    if (backend == INJECTION_UINPUT && uinput_open(debug) < 0) {
+        printf("uinput unavailable, falling back to XTest\n");
+        backend = INJECTION_XTEST;
+    }
+    if (backend == INJECTION_XTEST && xtest_open(debug) < 0) {
+        printf("XTest unavailable, falling back to xdotool\n");
+        backend = INJECTION_XDOTOOL_PIPE;
+    }
+    if (backend == INJECTION_XDOTOOL_PIPE && xdotool_open(debug) < 0) {
+        printf("xdotool coprocess unavailable, running xdotool per event\n");
+        backend = INJECTION_XDOTOOL;
+    }
+    handler_backend = backend;
+    return backend;
+}
+
+void handler_shutdown(void) {
+    release_held_key();
+    if (handler_backend == INJECTION_XTEST) {
+        xtest_close();
+    } else if (handler_backend == INJECTION_UINPUT) {
+        uinput_close();
+    } else if (handler_backend == INJECTION_XDOTOOL_PIPE) {
+        xdotool_close();
+    }
+    handler_backend = INJECTION_XDOTOOL;
+    launcher_shutdown();
+    plugin_unload_all();
+}
+
+// Send keys through the in-process backend. Returns -1 when xdotool has to
+// be used instead (xdotool backend, or a key the backend can't map).
+static int backend_key(const action_t* action, int type, int count) {
+    switch (handler_backend) {
+        case INJECTION_XTEST: return xtest_action(action, type, count);
+        case INJECTION_UINPUT: return uinput_action(action, type, count);
+        default: return -1;
+    }
+}
+
+static int backend_button(int button, int press) {
+    switch (handler_backend) {
+        case INJECTION_XTEST: return xtest_button(button, press);
+        case INJECTION_UINPUT: return uinput_button(button, press);
+        default: return -1;
+    }
+}
+
+static const char* backend_name(void) {
+    return handler_backend == INJECTION_UINPUT ? "uinput" : "XTest";
+}
+
+// Run an xdotool command: streamed to the coprocess when it is running,
+// otherwise through the shell
+static void run_xdotool(const char* args, int debug) {
+    // Keep the order of events already batched for XTest
+    handler_flush();
+
+    if (xdotool_running()) {
+        if (debug == 1) printf("xdotool: %s\n", args);
+        xdotool_send(args);
         return;
     }
 
-    if (strcmp(key, "NULL") == 0) {
+    char temp[strlen(args) + 9];
+    snprintf(temp, sizeof(temp), "xdotool %s", args);
+    if (debug == 1) printf("Executing: %s\n", temp);
+    system(temp);
+}
+
+static void release_timer_cb(void* user_data) {
+    (void)user_data;
+    release_held_key();
+}
+
+void handler_batch_begin(void) {
+    if (handler_backend == INJECTION_XTEST) xtest_batch_begin();
+}
+
+void handler_batch_end(void) {
+    if (handler_backend == INJECTION_XTEST) xtest_batch_end();
+}
+
+void handler_flush(void) {
+    if (handler_backend == INJECTION_XTEST) xtest_flush();
+}
+
+void handler_attach_reactor(reactor_t* reactor) {
+    // The held key can't outlive the timer that releases it
+    release_held_key();
+    if (release_timer) {
+        reactor_timer_destroy(release_timer);
+        release_timer = NULL;
+    }
+    if (reactor) {
+        release_timer = reactor_timer_create(reactor, release_timer_cb, NULL);
+    }
+
+    macro_attach_reactor(reactor);
+    xdotool_attach_reactor(reactor);
+    xtest_attach_reactor(reactor);
+    launcher_attach_reactor(reactor);
+}
+
+void handler_set_sink(handler_sink_t sink) {
+    handler_sink = sink;
+    handler_count = 0;
+}
+
+handler_sink_t handler_get_sink(void) {
+    return handler_sink;
+}
+
+long handler_get_count(void) {
+    return handler_count;
+}
+
+void handler_run(const char* command, int button, launch_policy_t policy, int debug) {
+    uint64_t start = latency_inject_begin();
+
+    if (handler_sink == HANDLER_SINK_REAL) {
+        if (debug == 1) printf("Launching: %s\n", command);
+        launcher_run(command, button, policy);
+    } else if (handler_sink == HANDLER_SINK_COUNT) {
+        handler_count++;
+    }
+    latency_inject_end(LAT_ACTION_PROGRAM, start);
+}
+
+void handler_plugin(const action_t* action, int button, int keypad, const char* profile, int debug) {
+    uint64_t start = latency_inject_begin();
+
+    if (handler_sink == HANDLER_SINK_REAL) {
+        if (debug == 1) printf("Plugin: %s\n", action->text);
+        plugin_run(action, button, keypad, profile);
+    } else if (handler_sink == HANDLER_SINK_COUNT) {
+        handler_count++;
+    }
+    latency_inject_end(LAT_ACTION_PLUGIN, start);
+}
+
+// Count or drop an event for the non-real sinks. Returns 1 if it was taken.
+static int sink_event(void) {
+    if (handler_sink == HANDLER_SINK_REAL) {
+        return 0;
+    }
+    if (handler_sink == HANDLER_SINK_COUNT) {
+        handler_count++;
+    }
+    return 1;
+}
+
+static const char* const KEY_COMMANDS[] = {"key", "keydown", "keyup"};
+
+// Keys the backend can't map go through xdotool, which can remap a keycode
+static void send_keys(const action_t* action, int type, int count, int debug) {
+    const char* command = KEY_COMMANDS[type + 1];
+
+    if (backend_key(action, type, count) == 0) {
+        if (debug == 1) {
+            if (count > 1) printf("%s: %s %s (x%d)\n", backend_name(), command, action->text, count);
+            else printf("%s: %s %s\n", backend_name(), command, action->text);
+        }
+        return;
+    }
+
+    char temp[strlen(action->text) + 48];
+    if (count > 1) {
+        snprintf(temp, sizeof(temp), "key --repeat %d --delay 0 %s", count, action->text);
+    } else {
+        snprintf(temp, sizeof(temp), "%s %s", command, action->text);
+    }
+    run_xdotool(temp, debug);
+}
+
+void handler_action(const action_t* action, int type, int debug) {
+    if (action == NULL || action->kind == ACTION_NONE || type < -1 || type > 1) {
+        return;
+    }
+    release_held_key();
+
+    uint64_t start = latency_inject_begin();
+    if (!sink_event()) {
+        send_keys(action, type, 1, debug);
+    }
+    latency_inject_end(type == -1 ? LAT_ACTION_KEY : LAT_ACTION_KEY_EDGE, start);
+}
+
+void handler_action_repeat(const action_t* action, int count, int debug) {
+    if (count <= 1 || handler_sink != HANDLER_SINK_REAL) {
+        handler_action(action, -1, debug);
+        return;
+    }
+    if (action == NULL || action->kind == ACTION_NONE) {
         return;
     }
+    release_held_key();
+
+    uint64_t start = latency_inject_begin();
+    send_keys(action, -1, count, debug);
+    latency_inject_end(LAT_ACTION_REPEAT, start);
+}
 
-    char* cmd = NULL;
-    int is_mouse = 0;
-    char mouse_char = '1';
-
-    switch(type) {
-        case -1:
-            cmd = "xdotool key ";
-            break;
-        case 0:
-            cmd = "xdotool keydown ";
-            break;
-        case 1:
-            cmd = "xdotool keyup ";
-            break;
-        case 2:
-            is_mouse = 1;
-            cmd = "xdotool mousedown ";
-            break;
-        case 3:
-            is_mouse = 1;
-            cmd = "xdotool mouseup ";
-            break;
-        default:
-            if (debug == 1) printf("Handler called with unknown type: %d\n", type);
-            return;
-    }
-
-    if (cmd == NULL) {
+void handler_mouse(int button, int press, int debug) {
+    if (button < 1 || button > 5) {
         return;
     }
+    release_held_key();
 
-    if (is_mouse) {
-        if (strlen(key) >= 6 && strncmp(key, "mouse", 5) == 0) {
-            mouse_char = key[5];
-            if (mouse_char < '1' || mouse_char > '5') {
-                mouse_char = '1';
-            }
+    uint64_t start = latency_inject_begin();
+    if (!sink_event()) {
+        const char* command = press ? "mousedown" : "mouseup";
+        if (backend_button(button, press) == 0) {
+            if (debug == 1) printf("%s: %s %d\n", backend_name(), command, button);
+        } else {
+            char temp[16];
+            snprintf(temp, sizeof(temp), "%s %d", command, button);
+            run_xdotool(temp, debug);
         }
+    }
+    latency_inject_end(LAT_ACTION_MOUSE, start);
+}
 
-        char temp[strlen(cmd) + 3];
-        snprintf(temp, sizeof(temp), "%s %c", cmd, mouse_char);
-        if (debug == 1) printf("Executing: %s\n", temp);
-        system(temp);
-    } else {
-        char temp[strlen(cmd) + strlen(key) + 1];
-        snprintf(temp, sizeof(temp), "%s%s", cmd, key);
-        if (debug == 1) printf("Executing: %s\n", temp);
-        system(temp);
+static void release_held_key(void) {
+    const action_t* action = held_key.action;
+    if (action == NULL) {
+        return;
+    }
+    held_key.action = NULL;
+    if (release_timer) {
+        reactor_timer_disarm(release_timer);
     }
+    handler_action(action, 1, held_key.debug);
+}
+
+void handler_release_held(void) {
+    release_held_key();
+}
+
+void handler_set_key_hold(int hold_ms) {
+    key_hold_ms = hold_ms < 0 ? 0 : hold_ms;
+}
+
+void handler_press(const action_t* action, int debug) {
+    if (action == NULL || action->kind == ACTION_NONE) {
+        return;
+    }
+
+    handler_action(action, 0, debug);
+
+    // Counting and dropping sinks don't hold keys; without a reactor the
+    // release can only wait inline
+    if (handler_sink != HANDLER_SINK_REAL || key_hold_ms == 0) {
+        handler_action(action, 1, debug);
+        return;
+    }
+    if (release_timer == NULL) {
+        usleep(key_hold_ms * 1000);
+        handler_action(action, 1, debug);
+        return;
+    }
+
+    held_key.action = action;
+    held_key.debug = debug;
+    reactor_timer_arm(release_timer, key_hold_ms, 0);
 }
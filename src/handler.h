@@ -1,8 +1,69 @@
 #ifndef HANDLER_H
 #define HANDLER_H
 
-// Event handler function
-// type: -1 = full key press, 0 = key down, 1 = key up, 2 = mouse down, 3 = mouse up
-void Handler(char* key, int type, int debug);
+#include "config.h"
+#include "reactor.h"
+#include "action.h"
+#include "launcher.h"
+#include "plugin.h"
+
+// Open the injection backend. Returns the backend actually in use
+// (uinput falls back to XTest, XTest to the xdotool coprocess, the
+// coprocess to running xdotool per event).
+injection_backend_t handler_init(injection_backend_t backend, int debug);
+void handler_shutdown(void);
+
+// Let the backend use the event loop (the xdotool coprocess drains its
+// queue when the pipe becomes writable, launched programs are reaped on
+// SIGCHLD). NULL detaches it.
+void handler_attach_reactor(reactor_t* reactor);
+
+// Where actions are sent
+typedef enum {
+    HANDLER_SINK_REAL,    // Send to the injection backend
+    HANDLER_SINK_COUNT,   // Count events, execute nothing
+    HANDLER_SINK_NULL     // Drop events
+} handler_sink_t;
+
+void handler_set_sink(handler_sink_t sink);
+handler_sink_t handler_get_sink(void);
+long handler_get_count(void);   // Events seen by the counting sink
+
+// Send a compiled action (see action.h)
+// type: -1 = full press, 0 = key down, 1 = key up
+void handler_action(const action_t* action, int type, int debug);
+
+// Key down now, key up once the key hold time has passed. The release
+// runs on a reactor timer so the event loop isn't blocked meanwhile; any
+// other injection releases the held key first, keeping events in order.
+// The action must stay valid until the release: call handler_release_held()
+// before freeing it.
+void handler_press(const action_t* action, int debug);
+
+// Release the key handler_press() holds down now
+void handler_release_held(void);
+
+// Key hold time of handler_press() (default 10ms, 0 = release at once)
+void handler_set_key_hold(int hold_ms);
+
+// Full press repeated count times in one injection
+void handler_action_repeat(const action_t* action, int count, int debug);
+
+// Injections between begin and end are sent in one batch where the
+// backend supports it (XTest: one flush). handler_flush() sends the open
+// batch early, e.g. before waiting.
+void handler_batch_begin(void);
+void handler_batch_end(void);
+void handler_flush(void);
+
+// Press or release mouse button 1-5
+void handler_mouse(int button, int press, int debug);
+
+// Send a plugin:<name>.<action> function to its plugin (see plugin.h)
+void handler_plugin(const action_t* action, int button, int keypad, const char* profile, int debug);
+
+// Launch a program/script (type 1 buttons) without waiting for it,
+// subject to the sink (see launcher.h)
+void handler_run(const char* command, int button, launch_policy_t policy, int debug);
 
 #endif // HANDLER_H
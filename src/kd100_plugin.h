@@ -0,0 +1,61 @@
+#ifndef KD100_PLUGIN_H
+#define KD100_PLUGIN_H
+
+// ============================================================================
+// ACTION PLUGIN ABI
+// ============================================================================
+//
+// A plugin is a shared object in the plugin_dir directory that exports
+// one kd100_plugin_t named kd100_plugin. A button whose function is
+// "plugin:<name>.<action>" calls the event callback of the plugin with
+// that name in-process, with <action> in event->action.
+//
+//   #include "kd100_plugin.h"
+//
+//   static void on_event(const kd100_event_t* event) {
+//       if (strcmp(event->action, "toggle_record") == 0) { ... }
+//   }
+//
+//   const kd100_plugin_t kd100_plugin = {
+//       KD100_PLUGIN_ABI_VERSION, "obs", NULL, NULL, on_event
+//   };
+//
+//   cc -shared -fPIC -o obs.so obs.c
+//
+// Callbacks run on the driver's event thread and must not block: hand
+// slow work to a thread of the plugin's own.
+//
+// An event carries the name of the profile in use, not the profile or
+// configuration itself: plugins keep whatever settings they need.
+//
+// ============================================================================
+
+// Bumped whenever a struct below changes
+#define KD100_PLUGIN_ABI_VERSION 1
+
+// Name of the exported kd100_plugin_t
+#define KD100_PLUGIN_SYMBOL "kd100_plugin"
+
+// Driver information handed to init
+typedef struct {
+    int abi_version;             // KD100_PLUGIN_ABI_VERSION of the driver
+    int debug;                   // Driver debug level (0-2)
+} kd100_host_t;
+
+// One action
+typedef struct {
+    const char* action;          // Text after "plugin:<name>." ("" if none)
+    const char* profile;         // Profile in use ("default" without one)
+    int button;                  // Button index (0-18)
+    int keypad;                  // Keypad slot the press came from
+} kd100_event_t;
+
+typedef struct {
+    int abi_version;             // KD100_PLUGIN_ABI_VERSION the plugin was built with
+    const char* name;            // <name> in "plugin:<name>.<action>"
+    int (*init)(const kd100_host_t* host);      // Optional; non-zero refuses to load
+    void (*fini)(void);                         // Optional; called before unloading
+    void (*event)(const kd100_event_t* event);  // Required
+} kd100_plugin_t;
+
+#endif // KD100_PLUGIN_H
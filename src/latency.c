@@ -0,0 +1,147 @@
+#include "latency.h"
+#include "utils.h"
+#include <stdio.h>
+#include <string.h>
+
+// Values below 16 ns get a bucket each; above that, 16 sub-buckets per
+// power of two up to 2^63
+#define SUB_BUCKETS   16
+#define BUCKET_COUNT  ((63 - 3) * SUB_BUCKETS + SUB_BUCKETS)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[BUCKET_COUNT];
+} histogram_t;
+
+static const char* STAGE_NAMES[LAT_STAGE_COUNT] = {
+    "decode", "leader", "inject start", "inject end", "osd", "done"
+};
+
+static const char* ACTION_NAMES[LAT_ACTION_COUNT] = {
+    "key", "key down/up", "mouse", "wheel repeat", "program", "plugin"
+};
+
+// Stages that keep their last timestamp instead of their first
+static const int STAGE_KEEP_LAST[LAT_STAGE_COUNT] = {0, 0, 0, 1, 1, 1};
+
+static int enabled = 0;
+static int in_report = 0;
+static uint64_t report_start;
+static uint64_t stage_time[LAT_STAGE_COUNT];
+static histogram_t stage_hist[LAT_STAGE_COUNT];
+static histogram_t action_hist[LAT_ACTION_COUNT];
+
+static int bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (int)((value >> (exponent - 4)) & (SUB_BUCKETS - 1));
+    return (exponent - 3) * SUB_BUCKETS + sub;
+}
+
+// Lowest value that lands in a bucket
+static uint64_t bucket_value(int index) {
+    if (index < SUB_BUCKETS) return (uint64_t)index;
+    int exponent = index / SUB_BUCKETS + 3;
+    uint64_t sub = (uint64_t)(index % SUB_BUCKETS);
+    return (SUB_BUCKETS + sub) << (exponent - 4);
+}
+
+static void histogram_record(histogram_t* hist, uint64_t value) {
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) hist->max = value;
+    hist->buckets[bucket_index(value)]++;
+}
+
+static uint64_t histogram_percentile(const histogram_t* hist, double percentile) {
+    uint64_t target = (uint64_t)(hist->count * percentile / 100.0 + 0.5);
+    uint64_t seen = 0;
+
+    if (target == 0) target = 1;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            uint64_t value = bucket_value(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void latency_enable(int on) {
+    enabled = on;
+}
+
+int latency_enabled(void) {
+    return enabled;
+}
+
+void latency_begin(void) {
+    if (!enabled) return;
+    memset(stage_time, 0, sizeof(stage_time));
+    report_start = get_time_ns();
+    in_report = 1;
+}
+
+void latency_mark(latency_stage_t stage) {
+    if (!enabled || !in_report) return;
+    if (stage_time[stage] == 0 || STAGE_KEEP_LAST[stage]) {
+        stage_time[stage] = get_time_ns();
+    }
+}
+
+void latency_end(void) {
+    if (!enabled || !in_report) return;
+
+    latency_mark(LAT_STAGE_DONE);
+    for (int i = 0; i < LAT_STAGE_COUNT; i++) {
+        if (stage_time[i] != 0) {
+            histogram_record(&stage_hist[i], stage_time[i] - report_start);
+        }
+    }
+    in_report = 0;
+}
+
+uint64_t latency_inject_begin(void) {
+    if (!enabled) return 0;
+    latency_mark(LAT_STAGE_INJECT_START);
+    return get_time_ns();
+}
+
+void latency_inject_end(latency_action_t action, uint64_t start) {
+    if (!enabled || start == 0) return;
+    uint64_t end = get_time_ns();
+    histogram_record(&action_hist[action], end - start);
+    if (in_report) {
+        stage_time[LAT_STAGE_INJECT_END] = end;
+    }
+}
+
+static void print_histogram(const char* name, const histogram_t* hist) {
+    printf("  %-14s %9llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+           (unsigned long long)hist->count,
+           hist->sum / (double)hist->count / 1000.0,
+           histogram_percentile(hist, 50.0) / 1000.0,
+           histogram_percentile(hist, 90.0) / 1000.0,
+           histogram_percentile(hist, 99.0) / 1000.0,
+           histogram_percentile(hist, 99.9) / 1000.0,
+           hist->max / 1000.0);
+}
+
+void latency_dump(void) {
+    if (!enabled) return;
+
+    printf("\n=== Latency (us) ===\n");
+    printf("  %-14s %9s %10s %10s %10s %10s %10s %10s\n",
+           "stage", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (int i = 0; i < LAT_STAGE_COUNT; i++) {
+        if (stage_hist[i].count > 0) print_histogram(STAGE_NAMES[i], &stage_hist[i]);
+    }
+    printf("  %-14s\n", "injection");
+    for (int i = 0; i < LAT_ACTION_COUNT; i++) {
+        if (action_hist[i].count > 0) print_histogram(ACTION_NAMES[i], &action_hist[i]);
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,278 @@
+#include "launcher.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+#include <sys/epoll.h>
+
+extern char** environ;
+
+// Counters since launcher_init(), printed at shutdown
+typedef struct {
+    long launched;
+    long queued;                 // Presses that had to wait
+    long dropped;                // Presses ignored (policy drop or full queue)
+    long spawn_failed;
+    long exit_ok;                // Exited with status 0
+    long exit_error;             // Non-zero status
+    long signaled;               // Killed by a signal
+    long long total_runtime_ns;  // Of reaped programs
+    long long max_runtime_ns;
+} launcher_stats_t;
+
+// Running program
+typedef struct {
+    pid_t pid;
+    int button;
+    uint64_t start_ns;
+} child_t;
+
+// Press waiting for its button or a free slot
+typedef struct {
+    char* command;
+    int button;
+} pending_t;
+
+static child_t children[LAUNCH_LIMIT_MAX];
+static int child_count = 0;
+static pending_t pending[LAUNCH_QUEUE_SIZE];
+static int pending_count = 0;
+
+static int launch_limit = LAUNCH_LIMIT_DEFAULT;
+static int launcher_debug = 0;
+static launcher_stats_t stats;
+
+static reactor_t* launcher_reactor = NULL;
+static reactor_source_t* sigchld_source = NULL;
+static int sigchld_fd = -1;
+
+const char* launch_policy_to_string(launch_policy_t policy) {
+    switch (policy) {
+        case LAUNCH_QUEUE: return "queue";
+        case LAUNCH_DROP: return "drop";
+        default: return "unknown";
+    }
+}
+
+static int button_running(int button) {
+    for (int i = 0; i < child_count; i++) {
+        if (children[i].button == button) return 1;
+    }
+    return 0;
+}
+
+static int button_pending(int button) {
+    for (int i = 0; i < pending_count; i++) {
+        if (pending[i].button == button) return 1;
+    }
+    return 0;
+}
+
+static int spawn(const char* command, int button) {
+    posix_spawnattr_t attr;
+    sigset_t mask, defaults;
+    pid_t pid;
+
+    // The program gets a clean signal state: nothing blocked (SIGCHLD is
+    // blocked here for the signalfd) and SIGPIPE not ignored
+    sigemptyset(&mask);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGCHLD);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    char* argv[] = {"sh", "-c", (char*)command, NULL};
+    fflush(stdout);
+    int err = posix_spawn(&pid, "/bin/sh", NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+
+    if (err != 0) {
+        printf("Cannot launch '%s': %s\n", command, strerror(err));
+        stats.spawn_failed++;
+        return -1;
+    }
+
+    children[child_count].pid = pid;
+    children[child_count].button = button;
+    children[child_count].start_ns = get_time_ns();
+    child_count++;
+    stats.launched++;
+    if (launcher_debug == 1) printf("Launched (pid %d): %s\n", (int)pid, command);
+    return 0;
+}
+
+// Start queued presses whose button is idle, oldest first
+static void start_pending(void) {
+    int i = 0;
+    while (i < pending_count && child_count < launch_limit) {
+        if (button_running(pending[i].button)) {
+            i++;
+            continue;
+        }
+        pending_t next = pending[i];
+        memmove(&pending[i], &pending[i + 1], (pending_count - i - 1) * sizeof(pending_t));
+        pending_count--;
+        spawn(next.command, next.button);
+        free(next.command);
+    }
+}
+
+static void account_exit(const child_t* child, int status) {
+    long long runtime = (long long)(get_time_ns() - child->start_ns);
+
+    stats.total_runtime_ns += runtime;
+    if (runtime > stats.max_runtime_ns) stats.max_runtime_ns = runtime;
+
+    if (WIFSIGNALED(status)) {
+        stats.signaled++;
+        if (launcher_debug == 1) {
+            printf("Program (pid %d) killed by signal %d after %.1f ms\n",
+                   (int)child->pid, WTERMSIG(status), runtime / 1e6);
+        }
+    } else {
+        if (WEXITSTATUS(status) == 0) stats.exit_ok++;
+        else stats.exit_error++;
+        if (launcher_debug == 1) {
+            printf("Program (pid %d) exited with status %d after %.1f ms\n",
+                   (int)child->pid, WEXITSTATUS(status), runtime / 1e6);
+        }
+    }
+}
+
+// Collect our children that have exited. Other children of the driver
+// (xdotool coprocess, simulator) are waited for by their owners.
+static void reap(void) {
+    int i = 0;
+    while (i < child_count) {
+        int status = 0;
+        pid_t r = waitpid(children[i].pid, &status, WNOHANG);
+        if (r == 0 || (r < 0 && errno == EINTR)) {
+            i++;
+            continue;
+        }
+        if (r > 0) {
+            account_exit(&children[i], status);
+        }
+        children[i] = children[--child_count];
+    }
+    start_pending();
+}
+
+static void on_sigchld(int fd, unsigned int events, void* user_data) {
+    struct signalfd_siginfo info;
+    (void)events;
+    (void)user_data;
+
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        // Signals coalesce, so every child is checked below
+    }
+    reap();
+}
+
+void launcher_init(int limit, int debug) {
+    if (limit < 1) limit = 1;
+    if (limit > LAUNCH_LIMIT_MAX) limit = LAUNCH_LIMIT_MAX;
+    launch_limit = limit;
+    launcher_debug = debug;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void launcher_attach_reactor(reactor_t* reactor) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+
+    if (sigchld_source) {
+        reactor_remove_fd(launcher_reactor, sigchld_source);
+        sigchld_source = NULL;
+    }
+    launcher_reactor = reactor;
+
+    if (reactor == NULL) {
+        if (sigchld_fd >= 0) {
+            close(sigchld_fd);
+            sigchld_fd = -1;
+            sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        }
+        return;
+    }
+
+    if (sigchld_fd < 0) {
+        sigprocmask(SIG_BLOCK, &mask, NULL);
+        sigchld_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (sigchld_fd < 0) {
+            sigprocmask(SIG_UNBLOCK, &mask, NULL);
+            return;
+        }
+    }
+    sigchld_source = reactor_add_fd(reactor, sigchld_fd, EPOLLIN, on_sigchld, NULL);
+
+    // Children that exited while nothing was watching
+    reap();
+}
+
+void launcher_shutdown(void) {
+    launcher_attach_reactor(NULL);
+    reap();
+
+    for (int i = 0; i < pending_count; i++) {
+        free(pending[i].command);
+        stats.dropped++;
+    }
+    pending_count = 0;
+
+    if (stats.launched > 0 || stats.dropped > 0 || stats.spawn_failed > 0) {
+        long reaped = stats.exit_ok + stats.exit_error + stats.signaled;
+        printf("Programs: %ld launched, %ld queued, %ld dropped, %ld failed to start\n",
+               stats.launched, stats.queued, stats.dropped, stats.spawn_failed);
+        printf("  exit 0: %ld, exit non-zero: %ld, killed: %ld, still running: %d\n",
+               stats.exit_ok, stats.exit_error, stats.signaled, child_count);
+        if (reaped > 0) {
+            printf("  runtime: avg %.1f ms, max %.1f ms\n",
+                   stats.total_runtime_ns / 1e6 / reaped, stats.max_runtime_ns / 1e6);
+        }
+    }
+
+    // Programs still running are left to finish on their own
+    child_count = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+int launcher_run(const char* command, int button, launch_policy_t policy) {
+    if (command == NULL) return -1;
+
+    // Without a reactor nothing reaps in the background
+    if (launcher_reactor == NULL) {
+        reap();
+    }
+
+    if (!button_running(button) && !button_pending(button) && child_count < launch_limit) {
+        return spawn(command, button);
+    }
+
+    if (policy == LAUNCH_DROP || pending_count >= LAUNCH_QUEUE_SIZE) {
+        stats.dropped++;
+        if (launcher_debug == 1) printf("Launch dropped (button %d busy): %s\n", button, command);
+        return -1;
+    }
+
+    pending[pending_count].command = strdup(command);
+    if (pending[pending_count].command == NULL) {
+        stats.dropped++;
+        return -1;
+    }
+    pending[pending_count].button = button;
+    pending_count++;
+    stats.queued++;
+    if (launcher_debug == 1) printf("Launch queued (button %d busy): %s\n", button, command);
+    return 0;
+}
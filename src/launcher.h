@@ -0,0 +1,50 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include "reactor.h"
+
+// ============================================================================
+// PROGRAM LAUNCHER
+// ============================================================================
+//
+// Starts type 1 button programs with posix_spawn ("/bin/sh -c command")
+// and returns at once, so a slow script no longer stalls report handling.
+// Children are reaped when SIGCHLD arrives on the reactor (signalfd); only
+// the launcher's own children are waited for.
+//
+// At most launch_limit programs run at once. A button's launch_policy
+// decides what happens while its previous program is still running or no
+// slot is free: "queue" starts it once possible, "drop" ignores the press.
+//
+// ============================================================================
+
+// Bounds of launch_limit
+#define LAUNCH_LIMIT_MAX    64
+#define LAUNCH_LIMIT_DEFAULT 4
+
+// Presses kept waiting for a slot
+#define LAUNCH_QUEUE_SIZE   32
+
+// What to do with a press while the button's program is still running
+typedef enum {
+    LAUNCH_QUEUE,    // Start it after the running one exits (default)
+    LAUNCH_DROP      // Ignore the press
+} launch_policy_t;
+
+void launcher_init(int limit, int debug);
+
+// Stop reaping; running programs are left alone, queued ones are dropped.
+// Prints the counters if anything was launched.
+void launcher_shutdown(void);
+
+// Reap children from this reactor's loop (NULL = detach; children are then
+// reaped before each launch)
+void launcher_attach_reactor(reactor_t* reactor);
+
+// Launch command for button (the key for launch_policy). Returns 0 when
+// started or queued, -1 when dropped or the spawn failed.
+int launcher_run(const char* command, int button, launch_policy_t policy);
+
+const char* launch_policy_to_string(launch_policy_t policy);
+
+#endif // LAUNCHER_H
@@ -1,37 +1,228 @@
 #include "leader.h"
 #include "utils.h"
+#include "handler.h"
+#include "latency.h"
+#include "macro.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
-#include <sys/time.h>
-
-// Forward declaration of Handler (implemented in handler module)
-void Handler(char* key, int type, int debug);
 
 // Reset leader state (but preserve toggle state for toggle mode)
 void reset_leader_state(leader_state* state) {
     state->leader_active = 0;
     state->last_button = -1;
-    state->leader_press_time.tv_sec = 0;
-    state->leader_press_time.tv_usec = 0;
+    state->leader_press_ms = 0;
+    state->sequence_node = 0;
     // Don't reset toggle_state here - it's managed separately
 }
 
+// ============================================================================
+// Sequence trie
+// ============================================================================
+
+static int trie_add_node(leader_trie_t* trie) {
+    if (trie->count >= 65535) return 0;
+    leader_node_t* nodes = realloc(trie->nodes, (trie->count + 1) * sizeof(leader_node_t));
+    if (nodes == NULL) return 0;
+    trie->nodes = nodes;
+    memset(&trie->nodes[trie->count], 0, sizeof(leader_node_t));
+    return trie->count++;
+}
+
+// Add one "<button> [<button>...] = <keys>" line. Returns 0, or -1 if it
+// isn't valid.
+static int trie_add(leader_trie_t* trie, const char* text, const event* events, int total_buttons) {
+    const char* equals = strchr(text, '=');
+    if (equals == NULL) return -1;
+
+    int buttons[LEADER_SEQUENCE_MAX];
+    int length = 0;
+    const char* p = text;
+    while (p < equals) {
+        if (*p == ' ' || *p == '\t') {
+            p++;
+            continue;
+        }
+        if (!isdigit((unsigned char)*p) || length == LEADER_SEQUENCE_MAX) return -1;
+        char* end;
+        long button = strtol(p, &end, 10);
+        // The wheel button and the leader can't be steps
+        if (button < 0 || button >= 18 || button >= total_buttons ||
+            (events[button].action && events[button].action->kind == ACTION_LEADER)) {
+            return -1;
+        }
+        buttons[length++] = (int)button;
+        p = end;
+    }
+    if (length == 0) return -1;
+
+    const char* keys = equals + 1;
+    while (*keys == ' ' || *keys == '\t') keys++;
+    if (*keys == '\0') return -1;
+    action_t* action = action_create(keys, 0);
+    if (action == NULL || action->kind != ACTION_KEYS) {
+        action_destroy(action);
+        return -1;
+    }
+
+    int node = 0;
+    for (int i = 0; i < length; i++) {
+        int next = trie->nodes[node].next[buttons[i]];
+        if (next == 0) {
+            next = trie_add_node(trie);
+            if (next == 0) {
+                action_destroy(action);
+                return -1;
+            }
+            trie->nodes[node].next[buttons[i]] = (unsigned short)next;
+            trie->nodes[node].next_mask |= 1u << buttons[i];
+        }
+        node = next;
+    }
+
+    // A later line for the same sequence wins
+    action_destroy(trie->nodes[node].action);
+    trie->nodes[node].action = action;
+    return 0;
+}
+
+// "3:ctrl+s 5:..." for the continuations of a node
+static char* node_hint(const leader_trie_t* trie, const leader_node_t* node) {
+    char hint[256];
+    size_t len = 0;
+    hint[0] = '\0';
+
+    for (int b = 0; b < 19 && len < sizeof(hint) - 1; b++) {
+        if (node->next[b] == 0) continue;
+        const leader_node_t* next = &trie->nodes[node->next[b]];
+        const char* label = next->next_mask || next->action == NULL ? "..." : next->action->text;
+        int n = snprintf(hint + len, sizeof(hint) - len, "%s%d:%s", len ? " " : "", b, label);
+        if (n < 0) break;
+        len += (size_t)n;
+    }
+    return len ? strdup(hint) : NULL;
+}
+
+leader_trie_t* leader_trie_create(char* const* sequences, int count,
+                                  const event* events, int total_buttons) {
+    if (count == 0) return NULL;
+
+    leader_trie_t* trie = calloc(1, sizeof(leader_trie_t));
+    if (trie == NULL) return NULL;
+    if (trie_add_node(trie) != 0) {
+        free(trie);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (sequences[i] == NULL) continue;
+        if (trie_add(trie, sequences[i], events, total_buttons) < 0) {
+            printf("Leader: invalid sequence \"%s\", ignored\n", sequences[i]);
+        }
+    }
+
+    // A first step that only starts longer sequences still sends the
+    // button's leader combination when nothing follows it
+    const leader_node_t* root = &trie->nodes[0];
+    for (int b = 0; b < 18 && b < total_buttons; b++) {
+        leader_node_t* first = root->next[b] ? &trie->nodes[root->next[b]] : NULL;
+        const action_t* action = events[b].action;
+        if (first && first->action == NULL && action && action->leader &&
+            events[b].leader_eligible == 1) {
+            first->action = action_copy(action->leader);
+        }
+    }
+
+    for (int i = 0; i < trie->count; i++) {
+        trie->nodes[i].hint = node_hint(trie, &trie->nodes[i]);
+    }
+    return trie;
+}
+
+void leader_trie_destroy(leader_trie_t* trie) {
+    if (trie == NULL) return;
+    for (int i = 0; i < trie->count; i++) {
+        action_destroy(trie->nodes[i].action);
+        free(trie->nodes[i].hint);
+    }
+    free(trie->nodes);
+    free(trie);
+}
+
+const leader_node_t* leader_sequence_node(const leader_state* state, const leader_trie_t* trie) {
+    if (trie == NULL) return NULL;
+    return &trie->nodes[state->sequence_node < trie->count ? state->sequence_node : 0];
+}
+
+// Leave the sequence; one-shot leaders end with it
+static void end_sequence(leader_state* state) {
+    state->sequence_node = 0;
+    if (state->mode == LEADER_MODE_ONE_SHOT) {
+        reset_leader_state(state);
+        state->toggle_state = 0;
+    }
+}
+
+void leader_sequence_expire(leader_state* state, const leader_trie_t* trie, int debug) {
+    const leader_node_t* node = leader_sequence_node(state, trie);
+    if (node == NULL || state->sequence_node == 0) return;
+
+    state->sequence_node = 0;
+    if (node->action) {
+        send_leader_combination(state, node->action, debug);
+    } else {
+        if (debug == 1) printf("Leader sequence timed out\n");
+        if (state->mode != LEADER_MODE_TOGGLE) {
+            reset_leader_state(state);
+            state->toggle_state = 0;
+        }
+    }
+}
+
+// One step of a sequence. Returns 1 if the press was taken by it.
+static int sequence_step(leader_state* state, const leader_trie_t* trie, int button_index, int debug) {
+    const leader_node_t* node = leader_sequence_node(state, trie);
+    if (node == NULL) return 0;
+
+    int next = node->next[button_index];
+    if (next == 0) {
+        if (state->sequence_node != 0) {
+            if (debug == 1) printf("Button %d doesn't continue the leader sequence\n", button_index);
+            end_sequence(state);
+        }
+        return 0;
+    }
+
+    const leader_node_t* child = &trie->nodes[next];
+    if (child->next_mask == 0) {
+        // Complete
+        state->sequence_node = 0;
+        latency_mark(LAT_STAGE_LEADER);
+        send_leader_combination(state, child->action, debug);
+        return 1;
+    }
+
+    // Wait for the next step
+    state->sequence_node = next;
+    state->leader_press_ms = get_time_ms();
+    if (debug == 1) printf("Leader sequence: %s\n", child->hint);
+    return 1;
+}
+
 // Send leader combination
-void send_leader_combination(leader_state* state, char* combination, int debug) {
-    if (combination == NULL || strlen(combination) == 0) {
+void send_leader_combination(leader_state* state, const action_t* combination, int debug) {
+    if (combination == NULL) {
         return;
     }
 
     if (debug == 1) {
-        printf("Sending leader combination: %s\n", combination);
+        printf("Sending leader combination: %s\n", combination->text);
     }
 
     // Send the combination
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "xdotool key %s", combination);
-    system(cmd);
+    handler_action(combination, -1, debug);
 
     // Reset leader state after sending (except for sticky and toggle modes)
     if (state->mode == LEADER_MODE_ONE_SHOT) {
@@ -39,40 +230,52 @@ void send_leader_combination(leader_state* state, char* combination, int debug)
         state->toggle_state = 0; // Also reset toggle for one_shot
     } else if (state->mode == LEADER_MODE_STICKY) {
         // Update timer for sticky mode
-        gettimeofday(&state->leader_press_time, NULL);
+        state->leader_press_ms = get_time_ms();
     }
     // For toggle mode, don't reset anything - stay active
 }
 
 // Process leader key combinations
-void process_leader_combination(leader_state* state, event* events, int button_index, int debug) {
+int process_leader_combination(leader_state* state, const leader_trie_t* trie,
+                               event* events, int button_index, int debug) {
     if (button_index < 0 || button_index >= 19) {
-        return;
+        return 0;
     }
 
     // Check if this is the wheel button (button 18) - handle specially
     if (button_index == 18) {
-        // Wheel button - handle normally without leader
-        if (events[button_index].function != NULL &&
-            strcmp(events[button_index].function, "swap") == 0) {
-            // Handle swap function
-            // (This would need wheel state tracking - implemented elsewhere)
-        }
-        // Don't reset leader state for wheel button in toggle mode
+        // Wheel button - handled normally without leader (swap is done by
+        // the dispatcher). Don't reset leader state in toggle mode
         if (state->mode != LEADER_MODE_TOGGLE) {
             reset_leader_state(state);
         }
-        return;
+        state->sequence_node = 0;
+        return 0;
     }
 
-    if (events[button_index].function == NULL) {
-        return;
+    const action_t* action = events[button_index].action;
+
+    // A step that comes too late ends the sequence so far first
+    if (state->sequence_node != 0) {
+        if (get_time_ms() - state->leader_press_ms > state->timeout_ms) {
+            leader_sequence_expire(state, trie, debug);
+        }
+    }
+
+    // Sequences come before the button's own leader combination (the
+    // leader itself is never a step)
+    int leader_on = state->mode == LEADER_MODE_TOGGLE ? state->toggle_state : state->leader_active;
+    if (leader_on && (action == NULL || action->kind != ACTION_LEADER) &&
+        sequence_step(state, trie, button_index, debug)) {
+        return 0;
     }
 
-    char* button_func = events[button_index].function;
+    if (action == NULL) {
+        return 0;
+    }
 
     // Check if this button is configured as a leader
-    if (strcmp(button_func, "leader") == 0) {
+    if (action->kind == ACTION_LEADER) {
         // This button is the leader itself
         if (state->mode == LEADER_MODE_TOGGLE) {
             // Toggle mode: press to enable, press again to disable
@@ -80,7 +283,7 @@ void process_leader_combination(leader_state* state, event* events, int button_i
                 // Enable toggle mode
                 state->toggle_state = 1;
                 state->leader_active = 1;
-                gettimeofday(&state->leader_press_time, NULL);
+                state->leader_press_ms = get_time_ms();
                 state->last_button = button_index;
 
                 if (debug == 1) {
@@ -101,7 +304,7 @@ void process_leader_combination(leader_state* state, event* events, int button_i
             if (!state->leader_active) {
                 // Activate leader mode
                 state->leader_active = 1;
-                gettimeofday(&state->leader_press_time, NULL);
+                state->leader_press_ms = get_time_ms();
                 state->last_button = button_index;
 
                 if (debug == 1) {
@@ -115,7 +318,7 @@ void process_leader_combination(leader_state* state, event* events, int button_i
                 }
             }
         }
-        return;
+        return 0;
     }
 
     // Check if we're in leader mode (either active or toggle mode is on)
@@ -125,8 +328,9 @@ void process_leader_combination(leader_state* state, event* events, int button_i
     }
 
     if (in_leader_mode) {
-        // Check eligibility first
-        if (events[button_index].leader_eligible == 0) {
+        // Check eligibility first (macros and plugins have no leader combination)
+        if (events[button_index].leader_eligible == 0 ||
+            action->kind == ACTION_MACRO || action->kind == ACTION_PLUGIN) {
             // Button is not eligible for leader modifications
             if (debug == 1) {
                 printf("Button %d not eligible for leader - handling normally\n", button_index);
@@ -141,9 +345,7 @@ void process_leader_combination(leader_state* state, event* events, int button_i
         } else {
             // Button is eligible for leader modifications
             // Calculate time since leader was pressed (for timeout)
-            struct timeval now;
-            gettimeofday(&now, NULL);
-            long elapsed = time_diff_ms(state->leader_press_time, now);
+            long elapsed = get_time_ms() - state->leader_press_ms;
 
             // Check timeout (skip for toggle mode)
             if (elapsed > state->timeout_ms && state->mode != LEADER_MODE_TOGGLE) {
@@ -156,43 +358,44 @@ void process_leader_combination(leader_state* state, event* events, int button_i
                 // Fall through to normal button handling
             } else {
                 // We have a leader combination!
-                // Format: leader_function + button_function
-                char combination[256] = "";
-
-                if (state->leader_function != NULL && strlen(state->leader_function) > 0) {
-                    strcpy(combination, state->leader_function);
-                    strcat(combination, "+");
-                }
-
-                strcat(combination, button_func);
-
-                // Send the combination
-                send_leader_combination(state, combination, debug);
+                // leader_function + button function, compiled with the config
+                latency_mark(LAT_STAGE_LEADER);
+                send_leader_combination(state, action->leader, debug);
 
                 // For sticky mode, update the timer to extend timeout
                 if (state->mode == LEADER_MODE_STICKY) {
-                    gettimeofday(&state->leader_press_time, NULL);
+                    state->leader_press_ms = get_time_ms();
                 }
 
-                return; // Don't also handle as normal button
+                return 0; // Don't also handle as normal button
             }
         }
     }
 
     // Not in leader mode, leader timed out, or button not eligible - handle normal button press
-    if (strcmp(button_func, "NULL") != 0 && strcmp(button_func, "swap") != 0 &&
-        strcmp(button_func, "mouse1") != 0 && strcmp(button_func, "mouse2") != 0 &&
-        strcmp(button_func, "mouse3") != 0 && strcmp(button_func, "mouse4") != 0 &&
-        strcmp(button_func, "mouse5") != 0) {
-
-        if (events[button_index].type == 0) {
-            // Type 0: Key press
-            Handler(button_func, 0, debug);
-            usleep(10000); // Small delay
-            Handler(button_func, 1, debug);
-        } else if (events[button_index].type == 1) {
+    latency_mark(LAT_STAGE_LEADER);
+    switch (action->kind) {
+        case ACTION_KEYS:
+            if (events[button_index].type != 0) break;
+            if (events[button_index].hold_mode == HOLD_MODE_HOLD) {
+                // Type 0 held: key up when the button is released
+                handler_action(action, 0, debug);
+            } else {
+                // Type 0: Key press, released later by the handler
+                handler_press(action, debug);
+            }
+            return 1;
+        case ACTION_PROGRAM:
             // Type 1: Run program/script
-            system(button_func);
-        }
+            handler_run(action->text, button_index, events[button_index].launch_policy, debug);
+            break;
+        case ACTION_MACRO:
+            // Type 3: Play macro
+            macro_play(action->macro, debug);
+            break;
+        default:
+            // Handled by the dispatcher
+            break;
     }
+    return 0;
 }
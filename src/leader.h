@@ -1,8 +1,9 @@
 #ifndef LEADER_H
 #define LEADER_H
 
-#include <sys/time.h>
 #include "utils.h"
+#include "action.h"
+#include "launcher.h"
 
 // Forward declaration
 typedef struct event event;
@@ -12,23 +13,78 @@ typedef struct {
     int leader_button;            // Which button is the leader (e.g., Button 16 for shift)
     int leader_active;            // Is leader mode active?
     int last_button;              // Last button pressed (for timing)
-    struct timeval leader_press_time; // When was leader pressed?
+    long leader_press_ms;         // When was leader pressed? (get_time_ms)
     char* leader_function;        // What function does the leader have?
     int timeout_ms;               // Leader timeout in milliseconds
     leader_mode_t mode;           // Leader mode (one_shot, sticky, toggle)
     int toggle_state;             // For toggle mode: 0 = off, 1 = on
+    int sequence_node;            // Trie node of the sequence so far (0 = none)
 } leader_state;
 
+// ============================================================================
+// LEADER SEQUENCES
+// ============================================================================
+//
+// "leader_sequence: 3 5 = ctrl+shift+p" binds keys to the leader followed
+// by buttons 3 and 5. The sequences are compiled with the configuration
+// into a prefix trie whose nodes index their children by button, so each
+// step is one array lookup. Every step restarts the leader timeout. A
+// sequence that is also the prefix of a longer one is sent when the
+// timeout expires without a further step; a button that doesn't continue
+// the sequence abandons it and is handled normally.
+//
+// ============================================================================
+
+#define LEADER_SEQUENCE_MAX 4            // Buttons after the leader
+#define LEADER_SEQUENCE_MAX_COUNT 512    // leader_sequence lines
+
+typedef struct {
+    unsigned short next[19];     // Child node per button (0 = none)
+    unsigned int next_mask;      // Bit n = next[n] is set
+    action_t* action;            // Sent when the sequence ends here (NULL = prefix only)
+    char* hint;                  // OSD text listing the continuations
+} leader_node_t;
+
+typedef struct {
+    leader_node_t* nodes;        // nodes[0] is the leader itself
+    int count;
+} leader_trie_t;
+
 // Event structure (button configuration)
 struct event {
     int type;
     char* function;
     int leader_eligible;  // 0 = not eligible, 1 = eligible, -1 = not set (default eligible)
+    action_t* action;     // Compiled function (NULL if none)
+    launch_policy_t launch_policy;  // Type 1: press while the program still runs
+    hold_mode_t hold_mode;          // Type 0/2: behaviour while the button is held
+    char* hold_function;            // Tap-hold: keys or mouseN held instead (NULL = none)
+    action_t* hold_action;          // Compiled hold_function
+    int hold_threshold_ms;          // Tap-hold: held this long = hold
+    tap_hold_mode_t tap_hold_mode;  // Tap-hold: effect of other buttons meanwhile
 };
 
 // Leader key functions
 void reset_leader_state(leader_state* state);
-void send_leader_combination(leader_state* state, char* combination, int debug);
-void process_leader_combination(leader_state* state, event* events, int button_index, int debug);
+void send_leader_combination(leader_state* state, const action_t* combination, int debug);
+// Returns 1 if the button's own type 0 keys were pressed (not a leader
+// combination), so the caller may hold or repeat them
+int process_leader_combination(leader_state* state, const leader_trie_t* trie,
+                               event* events, int button_index, int debug);
+
+// Compile "<button> [<button>...] = <keys>" sequences. A first step
+// without a sequence of its own keeps the button's leader combination.
+// Returns NULL if there are none (invalid ones are reported and skipped).
+leader_trie_t* leader_trie_create(char* const* sequences, int count,
+                                  const event* events, int total_buttons);
+void leader_trie_destroy(leader_trie_t* trie);
+
+// Trie node the sequence has reached (the root while none is in progress),
+// NULL without sequences
+const leader_node_t* leader_sequence_node(const leader_state* state, const leader_trie_t* trie);
+
+// The step timeout expired mid-sequence: send what the sequence so far is
+// bound to, if anything, and end it
+void leader_sequence_expire(leader_state* state, const leader_trie_t* trie, int debug);
 
 #endif // LEADER_H
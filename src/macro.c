@@ -0,0 +1,380 @@
+#include "macro.h"
+#include "handler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+
+// Keysym names of the punctuation "type" can send
+static const struct {
+    char c;
+    const char* name;
+} CHAR_NAMES[] = {
+    {' ', "space"}, {'!', "exclam"}, {'"', "quotedbl"}, {'#', "numbersign"},
+    {'$', "dollar"}, {'%', "percent"}, {'&', "ampersand"}, {'\'', "apostrophe"},
+    {'(', "parenleft"}, {')', "parenright"}, {'*', "asterisk"}, {'+', "plus"},
+    {',', "comma"}, {'-', "minus"}, {'.', "period"}, {'/', "slash"},
+    {':', "colon"}, {'<', "less"}, {'=', "equal"}, {'>', "greater"},
+    {'?', "question"}, {'@', "at"}, {'[', "bracketleft"}, {'\\', "backslash"},
+    {']', "bracketright"}, {'^', "asciicircum"}, {'_', "underscore"}, {'`', "grave"},
+    {'{', "braceleft"}, {'|', "bar"}, {'}', "braceright"}, {'~', "asciitilde"},
+};
+
+static const struct {
+    const char* verb;
+    macro_op_t op;
+} VERBS[] = {
+    {"key", MACRO_KEY}, {"keydown", MACRO_KEYDOWN}, {"keyup", MACRO_KEYUP},
+    {"type", MACRO_TYPE}, {"click", MACRO_CLICK}, {"mousedown", MACRO_MOUSEDOWN},
+    {"mouseup", MACRO_MOUSEUP}, {"delay", MACRO_DELAY},
+};
+
+// ============================================================================
+// Compilation
+// ============================================================================
+
+// Whole string as a number in min..max, -1 otherwise
+static int parse_number(const char* s, int min, int max) {
+    if (*s == '\0') return -1;
+    long n = 0;
+    for (const char* p = s; *p; p++) {
+        if (!isdigit((unsigned char)*p)) return -1;
+        n = n * 10 + (*p - '0');
+        if (n > max) return -1;
+    }
+    return n < min ? -1 : (int)n;
+}
+
+static char* trim(char* s) {
+    while (*s == ' ' || *s == '\t') s++;
+    size_t len = strlen(s);
+    while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\t')) s[--len] = '\0';
+    return s;
+}
+
+static action_t* char_action(char c) {
+    char name[2] = {c, '\0'};
+
+    if (isalnum((unsigned char)c)) {
+        return action_create(name, 0);
+    }
+    for (size_t i = 0; i < sizeof(CHAR_NAMES) / sizeof(CHAR_NAMES[0]); i++) {
+        if (CHAR_NAMES[i].c == c) {
+            return action_create(CHAR_NAMES[i].name, 0);
+        }
+    }
+    return NULL;
+}
+
+static void free_step(macro_step_t* step) {
+    action_destroy(step->action);
+    for (int i = 0; i < step->char_count; i++) {
+        action_destroy(step->chars[i]);
+    }
+    free(step->chars);
+}
+
+// Parse one step into *step. Returns 0, or -1 if it isn't valid.
+static int parse_step(char* text, macro_step_t* step) {
+    memset(step, 0, sizeof(*step));
+    step->count = 1;
+
+    // Trailing " *N" repeats the step
+    char* star = strrchr(text, '*');
+    if (star && star > text && star[-1] == ' ') {
+        int count = parse_number(trim(star + 1), 1, MACRO_MAX_COUNT);
+        if (count > 0) {
+            step->count = count;
+            *star = '\0';
+            text = trim(text);
+        }
+    }
+
+    size_t verb_len = strcspn(text, " ");
+    char* arg = trim(text + verb_len);
+    int found = 0;
+    for (size_t i = 0; i < sizeof(VERBS) / sizeof(VERBS[0]); i++) {
+        if (strlen(VERBS[i].verb) == verb_len && strncasecmp(text, VERBS[i].verb, verb_len) == 0) {
+            step->op = VERBS[i].op;
+            found = 1;
+            break;
+        }
+    }
+    if (!found || *arg == '\0') return -1;
+
+    switch (step->op) {
+        case MACRO_KEY:
+        case MACRO_KEYDOWN:
+        case MACRO_KEYUP:
+            step->action = action_create(arg, 0);
+            return step->action ? 0 : -1;
+
+        case MACRO_TYPE:
+            step->chars = calloc(strlen(arg), sizeof(action_t*));
+            if (step->chars == NULL) return -1;
+            for (const char* c = arg; *c; c++) {
+                action_t* action = char_action(*c);
+                if (action == NULL) return -1;
+                step->chars[step->char_count++] = action;
+            }
+            return 0;
+
+        case MACRO_CLICK:
+        case MACRO_MOUSEDOWN:
+        case MACRO_MOUSEUP:
+            step->value = parse_number(arg, 1, 5);
+            return step->value > 0 ? 0 : -1;
+
+        case MACRO_DELAY:
+            step->value = parse_number(arg, 0, MACRO_MAX_DELAY);
+            return step->value >= 0 ? 0 : -1;
+    }
+    return -1;
+}
+
+macro_t* macro_create(const char* text) {
+    if (text == NULL) return NULL;
+
+    macro_t* macro = calloc(1, sizeof(macro_t));
+    char* copy = strdup(text);
+    if (macro == NULL || copy == NULL) {
+        free(macro);
+        free(copy);
+        return NULL;
+    }
+    macro->text = strdup(text);
+    macro->repeat = 1;
+    macro->refs = 1;
+
+    int capacity = 1;
+    for (const char* p = text; *p; p++) {
+        if (*p == ';') capacity++;
+    }
+    macro->steps = calloc(capacity, sizeof(macro_step_t));
+    if (macro->text == NULL || macro->steps == NULL) {
+        free(copy);
+        macro_destroy(macro);
+        return NULL;
+    }
+
+    char* saveptr = NULL;
+    int repeat_seen = 0;
+    for (char* part = strtok_r(copy, ";", &saveptr); part; part = strtok_r(NULL, ";", &saveptr)) {
+        char* step_text = trim(part);
+        if (*step_text == '\0') continue;
+
+        if (repeat_seen) {
+            printf("Macro: \"repeat\" must be the last step: %s\n", text);
+            goto invalid;
+        }
+        if (strncasecmp(step_text, "repeat ", 7) == 0) {
+            macro->repeat = parse_number(trim(step_text + 7), 1, MACRO_MAX_COUNT);
+            if (macro->repeat < 0) {
+                printf("Macro: invalid repeat count \"%s\"\n", step_text);
+                goto invalid;
+            }
+            repeat_seen = 1;
+            continue;
+        }
+
+        macro_step_t* step = &macro->steps[macro->step_count];
+        if (parse_step(step_text, step) < 0) {
+            free_step(step);
+            printf("Macro: invalid step \"%s\"\n", step_text);
+            goto invalid;
+        }
+        macro->step_count++;
+    }
+    free(copy);
+    return macro;
+
+invalid:
+    free(copy);
+    macro_destroy(macro);
+    return NULL;
+}
+
+void macro_destroy(macro_t* macro) {
+    if (macro == NULL || --macro->refs > 0) return;
+
+    for (int i = 0; i < macro->step_count; i++) {
+        free_step(&macro->steps[i]);
+    }
+    free(macro->steps);
+    free(macro->text);
+    free(macro);
+}
+
+// ============================================================================
+// Player
+// ============================================================================
+
+static struct {
+    macro_t* macro;              // Playing (holds a reference), NULL = idle
+    int step;
+    int plays_left;
+    int debug;
+    const action_t* held_keys[MACRO_MAX_HELD];
+    int held_key_count;
+    int held_buttons;            // Bit n = mouse button n down
+} player;
+
+static reactor_timer_t* player_timer = NULL;
+
+static void release_held(void) {
+    for (int i = player.held_key_count - 1; i >= 0; i--) {
+        handler_action(player.held_keys[i], 1, player.debug);
+    }
+    player.held_key_count = 0;
+    for (int b = 1; b <= 5; b++) {
+        if (player.held_buttons & (1 << b)) {
+            handler_mouse(b, 0, player.debug);
+        }
+    }
+    player.held_buttons = 0;
+}
+
+static void finish(void) {
+    release_held();
+    if (player_timer) {
+        reactor_timer_disarm(player_timer);
+    }
+    macro_t* macro = player.macro;
+    player.macro = NULL;
+    macro_destroy(macro);
+}
+
+static void hold_key(const action_t* action) {
+    if (player.held_key_count < MACRO_MAX_HELD) {
+        player.held_keys[player.held_key_count++] = action;
+    }
+}
+
+static void unhold_key(const action_t* action) {
+    for (int i = 0; i < player.held_key_count; i++) {
+        // The same step text compiles to separate actions for keydown and keyup
+        if (strcmp(player.held_keys[i]->text, action->text) == 0) {
+            memmove(&player.held_keys[i], &player.held_keys[i + 1],
+                    (player.held_key_count - i - 1) * sizeof(player.held_keys[0]));
+            player.held_key_count--;
+            return;
+        }
+    }
+}
+
+static void run_steps(void) {
+    int debug = player.debug;
+
+    while (player.macro) {
+        if (player.step >= player.macro->step_count) {
+            if (--player.plays_left > 0) {
+                player.step = 0;
+                continue;
+            }
+            if (debug == 1) printf("Macro finished\n");
+            finish();
+            return;
+        }
+
+        const macro_step_t* step = &player.macro->steps[player.step++];
+        switch (step->op) {
+            case MACRO_KEY:
+                handler_action_repeat(step->action, step->count, debug);
+                break;
+            case MACRO_KEYDOWN:
+                handler_action(step->action, 0, debug);
+                hold_key(step->action);
+                break;
+            case MACRO_KEYUP:
+                handler_action(step->action, 1, debug);
+                unhold_key(step->action);
+                break;
+            case MACRO_TYPE:
+                for (int n = 0; n < step->count; n++) {
+                    for (int i = 0; i < step->char_count; i++) {
+                        handler_action(step->chars[i], -1, debug);
+                    }
+                }
+                break;
+            case MACRO_CLICK:
+                for (int n = 0; n < step->count; n++) {
+                    handler_mouse(step->value, 1, debug);
+                    handler_mouse(step->value, 0, debug);
+                }
+                break;
+            case MACRO_MOUSEDOWN:
+                handler_mouse(step->value, 1, debug);
+                player.held_buttons |= 1 << step->value;
+                break;
+            case MACRO_MOUSEUP:
+                handler_mouse(step->value, 0, debug);
+                player.held_buttons &= ~(1 << step->value);
+                break;
+            case MACRO_DELAY: {
+                long delay_ms = (long)step->value * step->count;
+                // Counting and dropping sinks don't wait
+                if (delay_ms == 0 || handler_get_sink() != HANDLER_SINK_REAL) break;
+                if (player_timer == NULL) {
+                    handler_flush();
+                    usleep(delay_ms * 1000);
+                    break;
+                }
+                reactor_timer_arm(player_timer, delay_ms, 0);
+                return;
+            }
+        }
+    }
+}
+
+// Run steps until a delay has to be waited for or the macro ends. The
+// injections of one run go out as one batch.
+static void run(void) {
+    handler_batch_begin();
+    run_steps();
+    handler_batch_end();
+}
+
+static void player_timer_cb(void* user_data) {
+    (void)user_data;
+    run();
+}
+
+void macro_play(macro_t* macro, int debug) {
+    if (macro == NULL) return;
+
+    // Pressing the button of the running macro stops it
+    if (player.macro == macro) {
+        if (debug == 1) printf("Macro stopped\n");
+        finish();
+        return;
+    }
+    macro_cancel();
+
+    if (debug == 1) printf("Macro: %s\n", macro->text);
+    macro->refs++;
+    player.macro = macro;
+    player.step = 0;
+    player.plays_left = macro->repeat;
+    player.debug = debug;
+    run();
+}
+
+void macro_cancel(void) {
+    if (player.macro == NULL) return;
+    if (player.debug == 1) printf("Macro stopped\n");
+    finish();
+}
+
+void macro_attach_reactor(reactor_t* reactor) {
+    // The macro can't outlive the timer that plays it
+    macro_cancel();
+    if (player_timer) {
+        reactor_timer_destroy(player_timer);
+        player_timer = NULL;
+    }
+    if (reactor) {
+        player_timer = reactor_timer_create(reactor, player_timer_cb, NULL);
+    }
+}
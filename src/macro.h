@@ -0,0 +1,78 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include "action.h"
+#include "reactor.h"
+
+// ============================================================================
+// MACROS
+// ============================================================================
+//
+// A type 3 button plays a macro: steps separated by ';'
+//   key <keys>        Full press (xdotool key syntax, as for type 0)
+//   keydown <keys>    Key down (released by keyup or when the macro ends)
+//   keyup <keys>      Key up
+//   type <text>       Type the text one character at a time (US layout)
+//   click <1-5>       Mouse button click
+//   mousedown <1-5>   Mouse button down (released by mouseup or at the end)
+//   mouseup <1-5>     Mouse button up
+//   delay <ms>        Wait
+// A step ending in "*N" runs N times; a last step "repeat N" plays the
+// whole macro N times.
+//
+// Macros are compiled with the configuration into a list of steps holding
+// compiled actions, and played from a reactor timer, so delays never
+// block input processing. Any button press stops a running macro;
+// pressing the macro's own button again stops it without restarting.
+//
+// ============================================================================
+
+#define MACRO_MAX_COUNT  1000   // Limit of "*N" and "repeat N"
+#define MACRO_MAX_DELAY  60000  // Longest single delay (ms)
+#define MACRO_MAX_HELD   16     // Keys held down by keydown at once
+
+typedef enum {
+    MACRO_KEY,
+    MACRO_KEYDOWN,
+    MACRO_KEYUP,
+    MACRO_TYPE,
+    MACRO_CLICK,
+    MACRO_MOUSEDOWN,
+    MACRO_MOUSEUP,
+    MACRO_DELAY
+} macro_op_t;
+
+typedef struct {
+    macro_op_t op;
+    int count;                   // Times the step runs
+    int value;                   // Mouse button or delay in ms
+    action_t* action;            // Key steps
+    action_t** chars;            // MACRO_TYPE: one action per character
+    int char_count;
+} macro_step_t;
+
+struct macro {
+    char* text;                  // Source string
+    macro_step_t* steps;
+    int step_count;
+    int repeat;                  // Plays of the whole macro
+    int refs;                    // The config and the player hold references
+};
+
+// Compile a macro string. Returns NULL (after printing why) if a step
+// can't be parsed.
+macro_t* macro_create(const char* text);
+
+// Drop a reference; the macro is freed once the player is done with it
+void macro_destroy(macro_t* macro);
+
+// Start playing (stops any other macro; stops this one if it is playing)
+void macro_play(macro_t* macro, int debug);
+
+// Stop the running macro, releasing keys and buttons it holds down
+void macro_cancel(void);
+
+// Play delays on this reactor. NULL detaches and stops a running macro.
+void macro_attach_reactor(reactor_t* reactor);
+
+#endif // MACRO_H
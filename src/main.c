@@ -24,6 +24,10 @@
 #include "config.h"
 #include "device.h"
 #include "compat.h"
+#include "decode.h"
+#include "capture.h"
+#include "handler.h"
+#include "latency.h"
 
 /* ===== CRASH HANDLER ===== */
 #ifdef DEBUG
@@ -141,8 +145,25 @@ void setup_crash_handler(void) {
 }
 #endif
 
-// Global keycodes array (used by utils module)
-int keycodes[] = {1, 2, 4, 8, 16, 32, 64, 128, 129, 130, 132, 136, 144, 160, 192, 256, 257, 258, 260, 641, 642};
+// Open the injection backend; xdotool is only required when it is used
+static int init_injection(config_t* config, handler_sink_t sink, int debug) {
+    if (sink != HANDLER_SINK_REAL) {
+        return 0;
+    }
+
+    launcher_init(config->launch_limit, debug);
+    injection_backend_t backend = handler_init(config->injection_backend, debug);
+    handler_set_key_hold(config->key_hold_ms);
+    // Recompile so plugin: functions point to their plugins
+    if (plugin_load_dir(config->plugin_dir, debug) > 0) config_compile_actions(config);
+    if (backend == INJECTION_XDOTOOL && system("xdotool sleep 0.01") != 0) {
+        printf("xdotool not found. It is needed when uinput/XTest are unavailable\n");
+        printf("or injection_backend is xdotool. Please install xdotool.\n");
+        printf("Exiting...\n");
+        return -9;
+    }
+    return 0;
+}
 
 int main(int args, char *in[]) {
 #ifdef DEBUG
@@ -153,24 +174,29 @@ int main(int args, char *in[]) {
     int debug = 0, accept = 0, dry = 0, err;
     char* file = "default.cfg";
     int enable_uclogic = 0;
-
-    // Check for xdotool
-    err = system("xdotool sleep 0.01");
-    if (err != 0) {
-        printf("xdotool not found. Please install xdotool for key simulation.\n");
-        printf("Exiting...\n");
-        return -9;
-    }
+    char* capture_path = NULL;
+    char* replay_path = NULL;
+    char* simulate = NULL;
+    int replay_fast = 0;
+    handler_sink_t sink = HANDLER_SINK_REAL;
 
     // Parse command-line arguments
     for (int arg = 1; arg < args; arg++) {
         if (strcmp(in[arg], "-h") == 0 || strcmp(in[arg], "--help") == 0) {
             printf("Usage: KD100 [option]...\n");
-            printf("\t-a\t\tAssume the first device that matches %04x:%04x is the Keydial\n", DEVICE_VID, DEVICE_PID);
+            printf("\t-a\t\tUse every device that matches %04x:%04x without prompting (multiple keypads)\n", DEVICE_VID, DEVICE_PID);
             printf("\t-c [path]\tSpecifies a config file to use\n");
             printf("\t-d [-d]\t\tEnable debug outputs (use twice to view data sent by the device)\n");
             printf("\t-dry \t\tDisplay data sent by the device without sending events\n");
             printf("\t-h\t\tDisplays this message\n");
+            printf("\t--bench-decode [n]\tBenchmark the report decoder over n reports and exit\n");
+            printf("\t--capture [path]\tRecord raw device reports to a capture file\n");
+            printf("\t--replay [path]\tFeed a capture file through the driver instead of a device\n");
+            printf("\t--replay-fast\tReplay as fast as possible instead of at recorded timing\n");
+            printf("\t--sink [real|count|null]\tWhere key events go (default: real)\n");
+            printf("\t--latency\tRecord per-stage latency histograms (dump: SIGUSR1, exit)\n");
+            printf("\t--simulate [spec]\tDrive simulated keypads instead of USB, e.g.\n");
+            printf("\t\t\trate=5000,count=100000,keypads=2,keys=70,wheel=20,chords=10\n");
             printf("\nNew in v1.7.2 - PROFILE SYSTEM OVERHAUL:\n");
             printf("\t• Per-app profiles in apps.profiles.d/ directory\n");
             printf("\t• Overlay semantics (only override keys, wheel, descriptions)\n");
@@ -183,6 +209,14 @@ int main(int args, char *in[]) {
             printf("\tDefault: enable_uclogic: false (compatible with OpenTabletDriver)\n\n");
             return 0;
         }
+        if (strcmp(in[arg], "--bench-decode") == 0) {
+            int iterations = 0;
+            if (arg + 1 < args) {
+                iterations = atoi(in[arg + 1]);
+            }
+            decode_benchmark(iterations);
+            return 0;
+        }
         if (strcmp(in[arg], "-d") == 0) {
             debug++;
         }
@@ -201,6 +235,49 @@ int main(int args, char *in[]) {
                 return -8;
             }
         }
+        if (strcmp(in[arg], "--capture") == 0) {
+            if (in[arg + 1]) {
+                capture_path = in[arg + 1];
+                arg++;
+            } else {
+                printf("No capture file specified. Exiting...\n");
+                return -8;
+            }
+        }
+        if (strcmp(in[arg], "--replay") == 0) {
+            if (in[arg + 1]) {
+                replay_path = in[arg + 1];
+                arg++;
+            } else {
+                printf("No capture file specified. Exiting...\n");
+                return -8;
+            }
+        }
+        if (strcmp(in[arg], "--simulate") == 0) {
+            if (in[arg + 1] && in[arg + 1][0] != '-') {
+                simulate = in[arg + 1];
+                arg++;
+            } else {
+                simulate = "";
+            }
+        }
+        if (strcmp(in[arg], "--latency") == 0) {
+            latency_enable(1);
+        }
+        if (strcmp(in[arg], "--replay-fast") == 0) {
+            replay_fast = 1;
+        }
+        if (strcmp(in[arg], "--sink") == 0) {
+            if (in[arg + 1] && strcmp(in[arg + 1], "count") == 0) {
+                sink = HANDLER_SINK_COUNT;
+            } else if (in[arg + 1] && strcmp(in[arg + 1], "null") == 0) {
+                sink = HANDLER_SINK_NULL;
+            } else if (!in[arg + 1] || strcmp(in[arg + 1], "real") != 0) {
+                printf("Unknown sink. Use real, count or null. Exiting...\n");
+                return -8;
+            }
+            arg++;
+        }
         if (strcmp(in[arg], "--uclogic") == 0) {
             enable_uclogic = 1;
             printf("Forcing hid_uclogic compatibility mode\n");
@@ -211,9 +288,43 @@ int main(int args, char *in[]) {
         }
     }
 
-    // Initialize libusb
+    handler_set_sink(sink);
+
+    // Replay needs neither a device nor libusb
+    if (replay_path) {
+        config_t* config = config_create();
+        if (config == NULL || config_load(config, file, debug) < 0) {
+            printf("Failed to load configuration from %s\n", file);
+            config_destroy(config);
+            return -1;
+        }
+        // Profiles for profile switch records (no window tracking)
+        profile_manager_t* profile_manager = NULL;
+        if (config->profile.profiles_dir || config->profile.profiles_file) {
+            profile_manager = profile_manager_create(config);
+            if (profile_manager != NULL) {
+                profile_manager_set_debug(profile_manager, debug);
+                if (!config->profile.profiles_dir ||
+                    profile_manager_load_dir(profile_manager, config->profile.profiles_dir) != 0) {
+                    if (config->profile.profiles_file) {
+                        profile_manager_load(profile_manager, config->profile.profiles_file);
+                    }
+                }
+            }
+        }
+        err = init_injection(config, sink, debug);
+        if (err == 0) {
+            err = capture_replay(replay_path, config, profile_manager, debug, replay_fast);
+        }
+        handler_shutdown();
+        profile_manager_destroy(profile_manager);
+        config_destroy(config);
+        return err;
+    }
+
+    // Initialize libusb (simulated keypads don't need it)
     libusb_context *ctx = NULL;
-    err = libusb_init(&ctx);
+    err = simulate ? 0 : libusb_init(&ctx);
     if (err < 0) {
         printf("Error initializing libusb: %d\n", err);
         return err;
@@ -223,14 +334,14 @@ int main(int args, char *in[]) {
     config_t* config = config_create();
     if (config == NULL) {
         printf("Failed to create configuration\n");
-        libusb_exit(ctx);
+        if (ctx) libusb_exit(ctx);
         return -1;
     }
 
     if (config_load(config, file, debug) < 0) {
         printf("Failed to load configuration from %s\n", file);
         config_destroy(config);
-        libusb_exit(ctx);
+        if (ctx) libusb_exit(ctx);
         return -1;
     }
 
@@ -239,6 +350,13 @@ int main(int args, char *in[]) {
         config->enable_uclogic = 1;
     }
 
+    err = init_injection(config, sink, debug);
+    if (err != 0) {
+        config_destroy(config);
+        if (ctx) libusb_exit(ctx);
+        return err;
+    }
+
     // Print startup information
     if (config->enable_uclogic) {
         printf("Mode: hid_uclogic compatibility enabled\n");
@@ -253,10 +371,13 @@ int main(int args, char *in[]) {
     printf("Features: OSD overlay | Per-app profiles | Hot reload | Overlay configs | Leader descriptions\n\n");
 
     // Run device handler
-    device_run(ctx, config, debug, accept, dry);
+    device_run(ctx, config, debug, accept, dry, capture_path, simulate);
 
     // Cleanup
+    handler_shutdown();
     config_destroy(config);
-    libusb_exit(ctx);
+    if (ctx) {
+        libusb_exit(ctx);
+    }
     return 0;
 }
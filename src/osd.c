@@ -1,8 +1,8 @@
 #include "osd.h"
+#include "latency.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
@@ -29,11 +29,9 @@ static const char* BUTTON_NAMES[] = {
     "B16", "B17", "WHEEL"
 };
 
-// Helper: get current time in milliseconds (osd-local version)
+// Helper: get current time in milliseconds (monotonic, see get_time_ms)
 static long osd_get_time_ms(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    return get_time_ms();
 }
 
 // Helper: find ARGB visual for transparency
@@ -103,10 +101,14 @@ osd_state_t* osd_create(config_t* config) {
     // Initialize active button state
     osd->active_button = -1;
     osd->active_button_time_ms = 0;
+    osd->last_redraw_ms = 0;
 
     // Initialize leader state
     osd->leader_active = 0;
     osd->leader_button = -1;
+    osd->leader_in_sequence = 0;
+    osd->leader_hint_mask = 0;
+    osd->leader_hint = NULL;
 
     // Initialize wheel state
     osd->wheel.current_set = 0;
@@ -139,6 +141,7 @@ void osd_destroy(osd_state_t* osd) {
         if (osd->key_descriptions[i]) free(osd->key_descriptions[i]);
         if (osd->leader_descriptions[i]) free(osd->leader_descriptions[i]);
     }
+    free(osd->leader_hint);
 
     // Free wheel descriptions
     for (int i = 0; i < 32; i++) {
@@ -420,9 +423,11 @@ static void draw_button_key(Display* dpy, Window win, GC gc, osd_state_t* osd,
     long now = osd_get_time_ms();
     int is_active = (osd->active_button == btn && (now - osd->active_button_time_ms) < 500);
     int is_leader = (osd->leader_active && btn == osd->leader_button);
-    int is_leader_modified = (osd->leader_active && btn != osd->leader_button &&
+    int is_leader_modified = (osd->leader_active && !osd->leader_in_sequence &&
+                              btn != osd->leader_button &&
                               osd->config && btn < osd->config->totalButtons &&
                               osd->config->events[btn].leader_eligible == 1);
+    int is_sequence_next = (osd->leader_active && (osd->leader_hint_mask & (1u << btn)));
 
     // Choose background color based on state
     unsigned long bg;
@@ -430,6 +435,8 @@ static void draw_button_key(Display* dpy, Window win, GC gc, osd_state_t* osd,
         bg = ((unsigned long)255 << 24) | 0x44AA44;  // Green for active press
     } else if (is_leader) {
         bg = ((unsigned long)255 << 24) | 0xAA6622;  // Orange for active leader
+    } else if (is_sequence_next) {
+        bg = ((unsigned long)220 << 24) | 0x2A5A5A;  // Teal for leader sequence steps
     } else if (is_leader_modified) {
         bg = ((unsigned long)220 << 24) | 0x3A3A5A;  // Subtle purple for leader-eligible
     } else {
@@ -589,6 +596,7 @@ void osd_redraw(osd_state_t* osd) {
     if (osd->active_button >= 0 && (now - osd->active_button_time_ms) > 500) {
         osd->active_button = -1;
     }
+    osd->last_redraw_ms = now;
 
     // Clear window
     XSetForeground(dpy, gc, bg_color);
@@ -659,7 +667,9 @@ void osd_redraw(osd_state_t* osd) {
         if (osd->leader_active) {
             unsigned long leader_on_color = ((unsigned long)255 << 24) | 0xEEAA33;
             XSetForeground(dpy, gc, leader_on_color);
-            const char* leader_text = "Leader: ON";
+            char leader_text[128];
+            snprintf(leader_text, sizeof(leader_text), "Leader: ON%s%s",
+                     osd->leader_hint ? "  " : "", osd->leader_hint ? osd->leader_hint : "");
             XDrawString(dpy, win, gc, padding, y_offset, leader_text, strlen(leader_text));
         } else {
             XSetForeground(dpy, gc, ((unsigned long)120 << 24) | 0x666666);
@@ -786,6 +796,7 @@ void osd_redraw(osd_state_t* osd) {
     }
 
     XFlush(dpy);
+    latency_mark(LAT_STAGE_OSD);
 }
 
 // Process X11 events
@@ -796,71 +807,72 @@ void osd_update(osd_state_t* osd) {
     Window win = (Window)osd->window;
     long now = osd_get_time_ms();
 
-    // Process X11 events first (to update cursor_inside before auto-hide check)
-    if (osd->mode != OSD_MODE_HIDDEN) {
-        while (XPending(dpy)) {
-            XEvent event;
-            XNextEvent(dpy, &event);
-
-            switch (event.type) {
-                case Expose:
-                    if (event.xexpose.count == 0) {
-                        osd_redraw(osd);
-                    }
-                    break;
-
-                case ButtonPress:
-                    if (event.xbutton.button == Button1) {
-                        // Start dragging from anywhere on the window
-                        osd->dragging = 1;
-                        osd->drag_start_x = event.xbutton.x_root - osd->pos_x;
-                        osd->drag_start_y = event.xbutton.y_root - osd->pos_y;
-                    }
-                    break;
-
-                case ButtonRelease:
-                    if (event.xbutton.button == Button1) {
-                        if (osd->dragging) {
-                            // If barely moved and clicked in title bar, toggle mode
-                            int dx = event.xbutton.x_root - osd->pos_x - osd->drag_start_x;
-                            int dy = event.xbutton.y_root - osd->pos_y - osd->drag_start_y;
-                            float scale = osd->font_size / 13.0f;
-                            int title_height = osd->font_size + (int)(12 * scale);
-                            if (abs(dx) < 5 && abs(dy) < 5 && event.xbutton.y < title_height) {
-                                osd_toggle_mode(osd);
-                            }
-                            osd->dragging = 0;
+    // Process X11 events first (to update cursor_inside before auto-hide check).
+    // The queue is drained even while hidden, otherwise the connection fd
+    // stays readable and the event loop would spin on it.
+    while (XPending(dpy)) {
+        XEvent event;
+        XNextEvent(dpy, &event);
+        if (osd->mode == OSD_MODE_HIDDEN) continue;
+
+        switch (event.type) {
+            case Expose:
+                if (event.xexpose.count == 0) {
+                    osd_redraw(osd);
+                }
+                break;
+
+            case ButtonPress:
+                if (event.xbutton.button == Button1) {
+                    // Start dragging from anywhere on the window
+                    osd->dragging = 1;
+                    osd->drag_start_x = event.xbutton.x_root - osd->pos_x;
+                    osd->drag_start_y = event.xbutton.y_root - osd->pos_y;
+                }
+                break;
+
+            case ButtonRelease:
+                if (event.xbutton.button == Button1) {
+                    if (osd->dragging) {
+                        // If barely moved and clicked in title bar, toggle mode
+                        int dx = event.xbutton.x_root - osd->pos_x - osd->drag_start_x;
+                        int dy = event.xbutton.y_root - osd->pos_y - osd->drag_start_y;
+                        float scale = osd->font_size / 13.0f;
+                        int title_height = osd->font_size + (int)(12 * scale);
+                        if (abs(dx) < 5 && abs(dy) < 5 && event.xbutton.y < title_height) {
+                            osd_toggle_mode(osd);
                         }
+                        osd->dragging = 0;
                     }
-                    break;
+                }
+                break;
 
-                case MotionNotify:
-                    if (osd->dragging) {
-                        // Consume all pending motion events (coalesce)
-                        while (XCheckTypedWindowEvent(dpy, win, MotionNotify, &event));
+            case MotionNotify:
+                if (osd->dragging) {
+                    // Consume all pending motion events (coalesce)
+                    while (XCheckTypedWindowEvent(dpy, win, MotionNotify, &event));
 
-                        osd->pos_x = event.xmotion.x_root - osd->drag_start_x;
-                        osd->pos_y = event.xmotion.y_root - osd->drag_start_y;
-                        XMoveWindow(dpy, win, osd->pos_x, osd->pos_y);
-                        XFlush(dpy);
-                    }
-                    break;
-
-                case ConfigureNotify:
-                    // Window was moved or resized
-                    break;
-
-                case EnterNotify:
-                    // Cursor entered the window - don't auto-hide while hovering
-                    osd->cursor_inside = 1;
-                    break;
-
-                case LeaveNotify:
-                    // Cursor left the window - restart auto-hide timer
-                    osd->cursor_inside = 0;
-                    osd->last_action_time_ms = osd_get_time_ms();
-                    break;
-            }
+                    osd->pos_x = event.xmotion.x_root - osd->drag_start_x;
+                    osd->pos_y = event.xmotion.y_root - osd->drag_start_y;
+                    XMoveWindow(dpy, win, osd->pos_x, osd->pos_y);
+                    XFlush(dpy);
+                }
+                break;
+
+            case ConfigureNotify:
+                // Window was moved or resized
+                break;
+
+            case EnterNotify:
+                // Cursor entered the window - don't auto-hide while hovering
+                osd->cursor_inside = 1;
+                break;
+
+            case LeaveNotify:
+                // Cursor left the window - restart auto-hide timer
+                osd->cursor_inside = 0;
+                osd->last_action_time_ms = osd_get_time_ms();
+                break;
         }
     }
 
@@ -873,25 +885,63 @@ void osd_update(osd_state_t* osd) {
         }
     }
 
-    // Check if we need to clear old actions and redraw
-    static long last_cleanup = 0;
-    if (now - last_cleanup > 500) {  // Check every 500ms
-        last_cleanup = now;
-
-        // Check if any visible actions have expired
-        int need_redraw = 0;
-        for (int i = 0; i < osd->recent_count; i++) {
+    // Redraw once when a recent action or the button highlight has expired
+    // since the last paint (osd_next_timeout_ms() schedules this wakeup)
+    int need_redraw = 0;
+    if (osd->active_button >= 0 && now - osd->active_button_time_ms > 500) {
+        need_redraw = 1;
+    }
+    if (osd->display_duration_ms > 0) {
+        for (int i = 0; i < osd->recent_count && !need_redraw; i++) {
             int idx = (osd->recent_head - 1 - i + 10) % 10;
-            long age = now - osd->recent_actions[idx].timestamp_ms;
-            if (age > osd->display_duration_ms && age < osd->display_duration_ms + 1000) {
+            long expiry = osd->recent_actions[idx].timestamp_ms + osd->display_duration_ms;
+            if (expiry > osd->last_redraw_ms && expiry < now) {
                 need_redraw = 1;
-                break;
             }
         }
-        if (need_redraw) {
-            osd_redraw(osd);
+    }
+    if (need_redraw) {
+        osd_redraw(osd);
+    }
+}
+
+// X11 connection fd, for the event loop
+int osd_get_fd(osd_state_t* osd) {
+    if (osd == NULL || osd->display == NULL) return -1;
+    return ConnectionNumber((Display*)osd->display);
+}
+
+// Milliseconds until osd_update() has time-based work to do (-1 = none)
+long osd_next_timeout_ms(osd_state_t* osd) {
+    if (osd == NULL || osd->display == NULL || osd->mode == OSD_MODE_HIDDEN) return -1;
+
+    long now = osd_get_time_ms();
+    long deadline = -1;
+
+    // Auto-hide
+    if (osd->auto_show && !osd->cursor_inside && osd->last_action_time_ms > 0) {
+        deadline = osd->last_action_time_ms + osd->display_duration_ms + 1;
+    }
+
+    // Button highlight expiry
+    if (osd->active_button >= 0) {
+        long expiry = osd->active_button_time_ms + 501;
+        if (deadline < 0 || expiry < deadline) deadline = expiry;
+    }
+
+    // Recent actions that are still painted but will expire
+    if (osd->display_duration_ms > 0) {
+        for (int i = 0; i < osd->recent_count; i++) {
+            int idx = (osd->recent_head - 1 - i + 10) % 10;
+            long expiry = osd->recent_actions[idx].timestamp_ms + osd->display_duration_ms + 1;
+            if (expiry > osd->last_redraw_ms && (deadline < 0 || expiry < deadline)) {
+                deadline = expiry;
+            }
         }
     }
+
+    if (deadline < 0) return -1;
+    return deadline > now ? deadline - now : 0;
 }
 
 // Set OSD position
@@ -973,7 +1023,7 @@ void osd_set_display_duration(osd_state_t* osd, int duration_ms) {
 }
 
 // Record a wheel action with aggregation (don't repeat same action)
-void osd_record_wheel_action(osd_state_t* osd, const char* direction, const char* description) {
+void osd_record_wheel_action(osd_state_t* osd, const char* direction, const char* description, int count) {
     if (osd == NULL) return;
 
     long now = osd_get_time_ms();
@@ -990,12 +1040,12 @@ void osd_record_wheel_action(osd_state_t* osd, const char* direction, const char
         strcmp(osd->wheel.last_wheel_action, action_str) == 0 &&
         (now - osd->wheel.last_wheel_time_ms) < 500) {
         osd->wheel.last_wheel_time_ms = now;
-        osd->wheel.wheel_action_count++;
+        osd->wheel.wheel_action_count += count;
     } else {
         if (osd->wheel.last_wheel_action) free(osd->wheel.last_wheel_action);
         osd->wheel.last_wheel_action = strdup(action_str);
         osd->wheel.last_wheel_time_ms = now;
-        osd->wheel.wheel_action_count = 1;
+        osd->wheel.wheel_action_count = count;
     }
 
     osd->last_action_time_ms = now;
@@ -1041,6 +1091,15 @@ void osd_set_active_button(osd_state_t* osd, int button_index) {
     }
 }
 
+void osd_set_leader_hint(osd_state_t* osd, int in_sequence, unsigned int mask, const char* hint) {
+    if (osd == NULL) return;
+    osd->leader_in_sequence = in_sequence;
+    osd->leader_hint_mask = mask;
+    if (osd->leader_hint && hint && strcmp(osd->leader_hint, hint) == 0) return;
+    free(osd->leader_hint);
+    osd->leader_hint = hint ? strdup(hint) : NULL;
+}
+
 // Set leader state for visual feedback
 void osd_set_leader_state(osd_state_t* osd, int active, int leader_button) {
     if (osd == NULL) return;
@@ -79,10 +79,14 @@ typedef struct {
     // Active button highlighting
     int active_button;            // Currently pressed button (-1 = none)
     long active_button_time_ms;   // When the button was pressed
+    long last_redraw_ms;          // When the window was last painted
 
     // Leader state feedback
     int leader_active;            // Is leader key currently active
     int leader_button;            // Which button is the leader
+    int leader_in_sequence;       // A leader sequence is in progress
+    unsigned int leader_hint_mask;  // Buttons continuing the leader sequence
+    char* leader_hint;            // Their bindings (NULL = none)
 
     // Wheel state
     osd_wheel_state_t wheel;
@@ -101,9 +105,11 @@ void osd_set_mode(osd_state_t* osd, osd_mode_t mode);
 
 // OSD update functions
 void osd_record_action(osd_state_t* osd, int button_index, const char* action);
-void osd_record_wheel_action(osd_state_t* osd, const char* direction, const char* description);
+void osd_record_wheel_action(osd_state_t* osd, const char* direction, const char* description, int count);
 void osd_update(osd_state_t* osd);       // Process X11 events and redraw if needed
 void osd_redraw(osd_state_t* osd);       // Force redraw
+int osd_get_fd(osd_state_t* osd);        // X11 connection fd for the event loop
+long osd_next_timeout_ms(osd_state_t* osd); // Time until next auto-hide/expiry (-1 = none)
 
 // OSD position functions
 void osd_set_position(osd_state_t* osd, int x, int y);
@@ -127,5 +133,8 @@ void osd_set_wheel_description(osd_state_t* osd, int index, const char* descript
 // Active button and leader state
 void osd_set_active_button(osd_state_t* osd, int button_index);
 void osd_set_leader_state(osd_state_t* osd, int active, int leader_button);
+// Continuations of the leader sequence (see leader.h); takes effect with
+// the next osd_set_leader_state()
+void osd_set_leader_hint(osd_state_t* osd, int in_sequence, unsigned int mask, const char* hint);
 
 #endif // OSD_H
@@ -0,0 +1,119 @@
+#include "plugin.h"
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <dlfcn.h>
+
+typedef struct {
+    void* handle;
+    const kd100_plugin_t* plugin;
+} loaded_plugin_t;
+
+static loaded_plugin_t plugins[MAX_PLUGINS];
+static int plugin_count = 0;
+static int plugin_debug = 0;
+
+static const kd100_plugin_t* find_plugin(const char* name, size_t len) {
+    for (int i = 0; i < plugin_count; i++) {
+        const char* loaded = plugins[i].plugin->name;
+        if (strlen(loaded) == len && strncmp(loaded, name, len) == 0) {
+            return plugins[i].plugin;
+        }
+    }
+    return NULL;
+}
+
+static void load_plugin(const char* path) {
+    void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        printf("Plugin: %s\n", dlerror());
+        return;
+    }
+
+    const kd100_plugin_t* plugin = dlsym(handle, KD100_PLUGIN_SYMBOL);
+    const char* problem = NULL;
+    if (plugin == NULL) {
+        problem = "no " KD100_PLUGIN_SYMBOL " symbol";
+    } else if (plugin->abi_version != KD100_PLUGIN_ABI_VERSION) {
+        problem = "built for another plugin ABI version";
+    } else if (plugin->name == NULL || plugin->name[0] == '\0' || strchr(plugin->name, '.')) {
+        problem = "invalid name";
+    } else if (plugin->event == NULL) {
+        problem = "no event callback";
+    } else if (find_plugin(plugin->name, strlen(plugin->name))) {
+        problem = "name already loaded";
+    } else if (plugin_count >= MAX_PLUGINS) {
+        problem = "too many plugins";
+    }
+    if (problem) {
+        printf("Plugin: %s: %s, not loaded\n", path, problem);
+        dlclose(handle);
+        return;
+    }
+
+    kd100_host_t host = {KD100_PLUGIN_ABI_VERSION, plugin_debug};
+    if (plugin->init && plugin->init(&host) != 0) {
+        printf("Plugin: %s: init failed, not loaded\n", path);
+        dlclose(handle);
+        return;
+    }
+
+    plugins[plugin_count].handle = handle;
+    plugins[plugin_count].plugin = plugin;
+    plugin_count++;
+    if (plugin_debug) printf("Plugin: loaded '%s' from %s\n", plugin->name, path);
+}
+
+int plugin_load_dir(const char* dir, int debug) {
+    plugin_debug = debug;
+    if (dir == NULL) return 0;
+
+    DIR* d = opendir(dir);
+    if (d == NULL) {
+        printf("Plugin: cannot open plugin directory %s\n", dir);
+        return 0;
+    }
+
+    int before = plugin_count;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= 3 || strcmp(entry->d_name + len - 3, ".so") != 0) continue;
+
+        char path[strlen(dir) + len + 2];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        load_plugin(path);
+    }
+    closedir(d);
+    return plugin_count - before;
+}
+
+void plugin_unload_all(void) {
+    for (int i = plugin_count - 1; i >= 0; i--) {
+        if (plugins[i].plugin->fini) plugins[i].plugin->fini();
+        dlclose(plugins[i].handle);
+    }
+    plugin_count = 0;
+}
+
+void plugin_resolve(action_t* action) {
+    if (action == NULL || action->kind != ACTION_PLUGIN) return;
+
+    const char* name = action->text + 7;
+    const char* dot = strchr(name, '.');
+    size_t name_len = dot ? (size_t)(dot - name) : strlen(name);
+
+    action->plugin = find_plugin(name, name_len);
+    action->plugin_action = dot ? dot + 1 : name + name_len;
+}
+
+int plugin_run(const action_t* action, int button, int keypad, const char* profile) {
+    if (action->plugin == NULL) {
+        if (plugin_debug == 1) printf("Plugin: no plugin for %s\n", action->text);
+        return -1;
+    }
+
+    kd100_event_t event = {action->plugin_action, profile ? profile : "default", button, keypad};
+    action->plugin->event(&event);
+    return 0;
+}
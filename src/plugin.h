@@ -0,0 +1,35 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include "kd100_plugin.h"
+#include "action.h"
+
+// ============================================================================
+// PLUGIN LOADER
+// ============================================================================
+//
+// Loads every *.so of the plugin directory with dlopen() at startup and
+// routes "plugin:<name>.<action>" functions to the plugin with that name
+// (see kd100_plugin.h for the ABI). The plugin and <action> are looked up
+// when the action is compiled, so a press only calls the plugin.
+//
+// ============================================================================
+
+#define MAX_PLUGINS 16
+
+// Load the plugins of dir (NULL = none). Returns the number loaded.
+int plugin_load_dir(const char* dir, int debug);
+
+// Call fini of every plugin and unload them
+void plugin_unload_all(void);
+
+// Look up the plugin and <action> of an ACTION_PLUGIN action (NULL or
+// other kinds are left alone). Actions compiled before plugin_load_dir
+// stay unresolved until they are compiled again.
+void plugin_resolve(action_t* action);
+
+// Send an ACTION_PLUGIN action to its plugin.
+// Returns -1 if no plugin of that name is loaded.
+int plugin_run(const action_t* action, int button, int keypad, const char* profile);
+
+#endif // PLUGIN_H
@@ -14,6 +14,28 @@
 // Helper functions
 // ============================================================================
 
+// Bump the generation and let the configs' users move on. Run before the
+// configs that went stale are freed.
+static void config_changed(profile_manager_t* manager) {
+    manager->generation++;
+    if (manager->on_change) {
+        manager->on_change(manager->on_change_data);
+    }
+}
+
+// Give a profile its overlay config. Its merged config is rebuilt on next
+// use; the old ones are freed once keypads have moved off them.
+static void set_profile_config(profile_manager_t* manager, profile_t* profile, config_t* config) {
+    config_t* old_config = profile->config;
+    config_t* old_bound = profile->bound_config;
+
+    profile->config = config;
+    profile->bound_config = NULL;
+    config_changed(manager);
+    config_destroy(old_bound);
+    config_destroy(old_config);
+}
+
 // Helper: free profile contents
 static void free_profile(profile_t* profile) {
     if (profile->name) { free(profile->name); profile->name = NULL; }
@@ -25,6 +47,10 @@ static void free_profile(profile_t* profile) {
         config_destroy(profile->config);
         profile->config = NULL;
     }
+    if (profile->bound_config) {
+        config_destroy(profile->bound_config);
+        profile->bound_config = NULL;
+    }
 
     // Free descriptions
     for (int i = 0; i < 19; i++) {
@@ -77,7 +103,7 @@ static void strip_comment(char* str) {
 
 // Helper: build a merged config (default overlaid with profile-specific overrides)
 // Only overlays: button events, wheel events, key/leader/wheel descriptions
-// Does NOT overlay: leader config, OSD, wheel_mode, enable_uclogic, profile settings
+// Does NOT overlay: leader config, OSD, wheel_mode, enable_uclogic, hotplug, profile settings
 static config_t* config_merge(const config_t* base, const config_t* overlay) {
     if (base == NULL) return NULL;
 
@@ -86,7 +112,15 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
 
     // Copy base settings that profiles should NOT change
     merged->enable_uclogic = base->enable_uclogic;
+    merged->hotplug = base->hotplug;
+    merged->injection_backend = base->injection_backend;
     merged->wheel_click_timeout_ms = base->wheel_click_timeout_ms;
+    merged->wheel_coalesce_ms = base->wheel_coalesce_ms;
+    merged->launch_limit = base->launch_limit;
+    merged->plugin_dir = base->plugin_dir ? strdup(base->plugin_dir) : NULL;
+    merged->key_hold_ms = base->key_hold_ms;
+    merged->repeat_delay_ms = base->repeat_delay_ms;
+    merged->repeat_rate = base->repeat_rate;
     merged->wheel_mode = base->wheel_mode;
     merged->osd = base->osd;
     merged->profile = base->profile;
@@ -98,11 +132,30 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
     merged->leader.leader_button = base->leader.leader_button;
     merged->leader.leader_active = base->leader.leader_active;
     merged->leader.last_button = base->leader.last_button;
-    merged->leader.leader_press_time = base->leader.leader_press_time;
+    merged->leader.leader_press_ms = base->leader.leader_press_ms;
     merged->leader.leader_function = base->leader.leader_function ? strdup(base->leader.leader_function) : NULL;
     merged->leader.timeout_ms = base->leader.timeout_ms;
     merged->leader.mode = base->leader.mode;
     merged->leader.toggle_state = base->leader.toggle_state;
+    if (base->leader_sequence_count > 0) {
+        merged->leader_sequences = calloc(base->leader_sequence_count, sizeof(char*));
+        if (merged->leader_sequences) {
+            for (int i = 0; i < base->leader_sequence_count; i++) {
+                merged->leader_sequences[i] = strdup(base->leader_sequences[i]);
+            }
+            merged->leader_sequence_count = base->leader_sequence_count;
+        }
+    }
+    if (base->chord_count > 0) {
+        merged->chords = calloc(base->chord_count, sizeof(char*));
+        if (merged->chords) {
+            for (int i = 0; i < base->chord_count; i++) {
+                merged->chords[i] = strdup(base->chords[i]);
+            }
+            merged->chord_count = base->chord_count;
+        }
+    }
+    merged->chord_window_ms = base->chord_window_ms;
 
     // Copy button events from base
     if (base->totalButtons > 0) {
@@ -114,6 +167,13 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
                 merged->events[i].type = base->events[i].type;
                 merged->events[i].function = base->events[i].function ? strdup(base->events[i].function) : NULL;
                 merged->events[i].leader_eligible = base->events[i].leader_eligible;
+                merged->events[i].action = NULL;
+                merged->events[i].launch_policy = base->events[i].launch_policy;
+                merged->events[i].hold_mode = base->events[i].hold_mode;
+                merged->events[i].hold_function = base->events[i].hold_function ? strdup(base->events[i].hold_function) : NULL;
+                merged->events[i].hold_action = NULL;
+                merged->events[i].hold_threshold_ms = base->events[i].hold_threshold_ms;
+                merged->events[i].tap_hold_mode = base->events[i].tap_hold_mode;
             }
         }
     }
@@ -128,6 +188,8 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
                 merged->wheelEvents[i].right = base->wheelEvents[i].right ? strdup(base->wheelEvents[i].right) : NULL;
                 merged->wheelEvents[i].left = base->wheelEvents[i].left ? strdup(base->wheelEvents[i].left) : NULL;
                 merged->wheelEvents[i].description = base->wheelEvents[i].description ? strdup(base->wheelEvents[i].description) : NULL;
+                merged->wheelEvents[i].right_action = NULL;
+                merged->wheelEvents[i].left_action = NULL;
             }
         }
     }
@@ -139,7 +201,10 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
     }
 
     // Now overlay profile-specific values (if overlay is provided)
-    if (overlay == NULL) return merged;
+    if (overlay == NULL) {
+        config_compile_actions(merged);
+        return merged;
+    }
 
     // Overlay button events (only buttons that the overlay defines)
     for (int i = 0; i < overlay->totalButtons; i++) {
@@ -153,6 +218,13 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
                         merged->events[j].function = NULL;
                         merged->events[j].type = 0;
                         merged->events[j].leader_eligible = -1;
+                        merged->events[j].action = NULL;
+                        merged->events[j].launch_policy = LAUNCH_QUEUE;
+                        merged->events[j].hold_mode = HOLD_MODE_TAP;
+                        merged->events[j].hold_function = NULL;
+                        merged->events[j].hold_action = NULL;
+                        merged->events[j].hold_threshold_ms = 200;
+                        merged->events[j].tap_hold_mode = TAP_HOLD_TIMEOUT;
                     }
                     merged->totalButtons = i + 1;
                 }
@@ -161,6 +233,13 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
                 if (merged->events[i].function) free(merged->events[i].function);
                 merged->events[i].function = strdup(overlay->events[i].function);
                 merged->events[i].type = overlay->events[i].type;
+                merged->events[i].launch_policy = overlay->events[i].launch_policy;
+                merged->events[i].hold_mode = overlay->events[i].hold_mode;
+                free(merged->events[i].hold_function);
+                merged->events[i].hold_function = overlay->events[i].hold_function ?
+                                                  strdup(overlay->events[i].hold_function) : NULL;
+                merged->events[i].hold_threshold_ms = overlay->events[i].hold_threshold_ms;
+                merged->events[i].tap_hold_mode = overlay->events[i].tap_hold_mode;
                 if (overlay->events[i].leader_eligible != -1) {
                     merged->events[i].leader_eligible = overlay->events[i].leader_eligible;
                 }
@@ -179,6 +258,8 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
                         merged->wheelEvents[j].right = NULL;
                         merged->wheelEvents[j].left = NULL;
                         merged->wheelEvents[j].description = NULL;
+                        merged->wheelEvents[j].right_action = NULL;
+                        merged->wheelEvents[j].left_action = NULL;
                     }
                     merged->totalWheels = i + 1;
                 }
@@ -212,6 +293,7 @@ static config_t* config_merge(const config_t* base, const config_t* overlay) {
         }
     }
 
+    config_compile_actions(merged);
     return merged;
 }
 
@@ -334,8 +416,8 @@ static void validate_config(const char* filename, const config_t* cfg) {
             fprintf(stderr, "Error: %s: Button %d is out of range (valid: 0-18)\n", filename, i);
             continue;
         }
-        if (cfg->events[i].type < 0 || cfg->events[i].type > 2) {
-            fprintf(stderr, "Error: %s: Button %d has invalid type %d (valid: 0, 1, 2)\n",
+        if (cfg->events[i].type < 0 || cfg->events[i].type > 3) {
+            fprintf(stderr, "Error: %s: Button %d has invalid type %d (valid: 0, 1, 2, 3)\n",
                     filename, i, cfg->events[i].type);
         }
         if (cfg->events[i].type >= 0 && cfg->events[i].function == NULL) {
@@ -414,6 +496,20 @@ int profile_manager_init(profile_manager_t* manager, void* display, osd_state_t*
     return 0;
 }
 
+void profile_manager_set_change_callback(profile_manager_t* manager, profile_change_cb callback,
+                                         void* user_data) {
+    if (manager == NULL) return;
+    manager->on_change = callback;
+    manager->on_change_data = user_data;
+}
+
+void profile_manager_set_reload_callback(profile_manager_t* manager, profile_reload_cb callback,
+                                         void* user_data) {
+    if (manager == NULL) return;
+    manager->on_reload = callback;
+    manager->on_reload_data = user_data;
+}
+
 // ============================================================================
 // Profile management
 // ============================================================================
@@ -437,6 +533,7 @@ int profile_add(profile_manager_t* manager, const char* name, const char* window
     profile->source_file = source_file ? strdup(source_file) : NULL;
     profile->priority = priority;
     profile->config = NULL;
+    profile->bound_config = NULL;
     profile->is_default = 0;
 
     for (int i = 0; i < 19; i++) {
@@ -448,6 +545,7 @@ int profile_add(profile_manager_t* manager, const char* name, const char* window
     }
 
     manager->profile_count++;
+    config_changed(manager);
 
     if (manager->debug) {
         printf("Profile added: '%s' (pattern: '%s', priority: %d, source: %s)\n",
@@ -463,7 +561,8 @@ int profile_remove(profile_manager_t* manager, const char* name) {
 
     for (int i = 0; i < manager->profile_count; i++) {
         if (manager->profiles[i].name && strcmp(manager->profiles[i].name, name) == 0) {
-            free_profile(&manager->profiles[i]);
+            // Keypads bound to it may still use its merged config
+            profile_t removed = manager->profiles[i];
 
             for (int j = i; j < manager->profile_count - 1; j++) {
                 manager->profiles[j] = manager->profiles[j + 1];
@@ -478,6 +577,8 @@ int profile_remove(profile_manager_t* manager, const char* name) {
                 manager->active_profile_index--;
             }
 
+            config_changed(manager);
+            free_profile(&removed);
             return 0;
         }
     }
@@ -608,14 +709,13 @@ int profile_manager_update(profile_manager_t* manager) {
     int old_index = manager->active_profile_index;
     manager->active_profile_index = best_index;
 
-    // Build merged config (default overlaid with profile overrides)
-    if (manager->merged_config) {
-        config_destroy(manager->merged_config);
-        manager->merged_config = NULL;
-    }
-
+    // Build merged config (default overlaid with profile overrides). The
+    // old one is freed once nothing uses it.
+    config_t* old_config = manager->merged_config;
     profile_t* profile = &manager->profiles[best_index];
     manager->merged_config = config_merge(manager->default_config, profile->config);
+    config_changed(manager);
+    config_destroy(old_config);
 
     if (manager->debug) {
         printf("Profile switched: '%s'", profile->name);
@@ -650,6 +750,16 @@ config_t* profile_manager_get_config(profile_manager_t* manager) {
     return manager->default_config;
 }
 
+config_t* profile_manager_get_profile_config(profile_manager_t* manager, const char* name) {
+    profile_t* profile = profile_get(manager, name);
+    if (profile == NULL) return NULL;
+
+    if (profile->bound_config == NULL) {
+        profile->bound_config = config_merge(manager->default_config, profile->config);
+    }
+    return profile->bound_config;
+}
+
 int profile_manager_switch(profile_manager_t* manager, const char* name) {
     if (manager == NULL || name == NULL) return -1;
 
@@ -667,14 +777,12 @@ int profile_manager_switch_by_index(profile_manager_t* manager, int index) {
 
     manager->active_profile_index = index;
 
-    // Rebuild merged config
-    if (manager->merged_config) {
-        config_destroy(manager->merged_config);
-        manager->merged_config = NULL;
-    }
-
+    // Rebuild merged config, freeing the old one once nothing uses it
+    config_t* old_config = manager->merged_config;
     profile_t* profile = &manager->profiles[index];
     manager->merged_config = config_merge(manager->default_config, profile->config);
+    config_changed(manager);
+    config_destroy(old_config);
 
     // Update OSD
     apply_profile_to_osd(manager, profile);
@@ -778,19 +886,17 @@ int profile_manager_load(profile_manager_t* manager, const char* filename) {
                         // Load overlay config if specified
                         if (current_config) {
                             profile_t* p = profile_get(manager, current_profile);
-                            if (p) {
-                                p->config = config_create();
-                                if (p->config) {
-                                    if (config_load(p->config, current_config, manager->debug) < 0) {
-                                        if (manager->debug) {
-                                            printf("Profile '%s': Failed to load config '%s'\n",
-                                                   current_profile, current_config);
-                                        }
-                                        config_destroy(p->config);
-                                        p->config = NULL;
-                                    } else {
-                                        validate_config(current_config, p->config);
+                            config_t* overlay = p ? config_create() : NULL;
+                            if (overlay) {
+                                if (config_load(overlay, current_config, manager->debug) < 0) {
+                                    if (manager->debug) {
+                                        printf("Profile '%s': Failed to load config '%s'\n",
+                                               current_profile, current_config);
                                     }
+                                    config_destroy(overlay);
+                                } else {
+                                    validate_config(current_config, overlay);
+                                    set_profile_config(manager, p, overlay);
                                 }
                             }
                         }
@@ -884,15 +990,13 @@ int profile_manager_load(profile_manager_t* manager, const char* filename) {
                 }
                 if (current_config) {
                     profile_t* p = profile_get(manager, current_profile);
-                    if (p) {
-                        p->config = config_create();
-                        if (p->config) {
-                            if (config_load(p->config, current_config, manager->debug) < 0) {
-                                config_destroy(p->config);
-                                p->config = NULL;
-                            } else {
-                                validate_config(current_config, p->config);
-                            }
+                    config_t* overlay = p ? config_create() : NULL;
+                    if (overlay) {
+                        if (config_load(overlay, current_config, manager->debug) < 0) {
+                            config_destroy(overlay);
+                        } else {
+                            validate_config(current_config, overlay);
+                            set_profile_config(manager, p, overlay);
                         }
                     }
                 }
@@ -1086,14 +1190,14 @@ static int load_profile_file(profile_manager_t* manager, const char* filepath) {
 
     // Load overlay config from the same file (reuses config_load which parses
     // Button/Wheel/function lines)
-    p->config = config_create();
-    if (p->config) {
-        if (config_load(p->config, filepath, manager->debug) < 0) {
+    config_t* overlay = config_create();
+    if (overlay) {
+        if (config_load(overlay, filepath, manager->debug) < 0) {
             // No button/wheel overrides in this file - that's fine
-            config_destroy(p->config);
-            p->config = NULL;
+            config_destroy(overlay);
         } else {
-            validate_config(basename, p->config);
+            validate_config(basename, overlay);
+            set_profile_config(manager, p, overlay);
         }
     }
 
@@ -1217,6 +1321,63 @@ void profile_manager_watch_stop(profile_manager_t* manager) {
     }
 }
 
+int profile_manager_reload_file(profile_manager_t* manager, const char* filename) {
+    if (manager == NULL || filename == NULL) return -1;
+
+    char filepath[MAX_PROFILE_PATH + 256 + 2];
+    snprintf(filepath, sizeof(filepath), "%s/%s", manager->profiles_dir, filename);
+
+    // Find existing profile from this file
+    int found = -1;
+    for (int i = 0; i < manager->profile_count; i++) {
+        if (manager->profiles[i].source_file &&
+            strcmp(manager->profiles[i].source_file, filepath) == 0) {
+            found = i;
+            break;
+        }
+    }
+
+    struct stat st;
+    if (stat(filepath, &st) != 0) {
+        // File deleted: remove profile
+        if (found < 0) return 0;
+        printf("Removing profile from deleted file %s\n", filename);
+        profile_remove(manager, manager->profiles[found].name);
+        return 1;
+    }
+
+    // File created or modified: reload
+    printf("Refreshing configuration for profile %s\n", filename);
+
+    if (found < 0) {
+        // New file: load as new profile
+        printf("Loading new profile from %s\n", filename);
+        return load_profile_file(manager, filepath) == 0 ? 1 : 0;
+    }
+
+    // Remove old profile
+    int was_active = (found == manager->active_profile_index);
+    char* old_name = manager->profiles[found].name ?
+                     strdup(manager->profiles[found].name) : NULL;
+    profile_remove(manager, manager->profiles[found].name);
+
+    // Reload from file
+    int reloaded = 0;
+    if (load_profile_file(manager, filepath) == 0) {
+        reloaded = 1;
+        if (was_active) {
+            // Re-activate the profile by name if it still exists
+            if (old_name) {
+                profile_manager_switch(manager, old_name);
+            }
+        }
+    } else {
+        fprintf(stderr, "Error: Failed to reload %s (profile removed)\n", filename);
+    }
+    if (old_name) free(old_name);
+    return reloaded;
+}
+
 int profile_manager_check_reload(profile_manager_t* manager) {
     if (manager == NULL || manager->inotify_fd < 0) return -1;
 
@@ -1233,62 +1394,11 @@ int profile_manager_check_reload(profile_manager_t* manager) {
         if (ev->len > 0 && ev->name[0] != '.') {
             // Only process .cfg files
             size_t namelen = strlen(ev->name);
-            if (namelen >= 5 && strcasecmp(ev->name + namelen - 4, ".cfg") == 0) {
-                char filepath[MAX_PROFILE_PATH + 256 + 2];
-                snprintf(filepath, sizeof(filepath), "%s/%s", manager->profiles_dir, ev->name);
-
-                if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)) {
-                    // File created or modified: reload
-                    printf("Refreshing configuration for profile %s\n", ev->name);
-
-                    // Find existing profile from this file
-                    int found = -1;
-                    for (int i = 0; i < manager->profile_count; i++) {
-                        if (manager->profiles[i].source_file &&
-                            strcmp(manager->profiles[i].source_file, filepath) == 0) {
-                            found = i;
-                            break;
-                        }
-                    }
-
-                    if (found >= 0) {
-                        // Remove old profile
-                        int was_active = (found == manager->active_profile_index);
-                        char* old_name = manager->profiles[found].name ?
-                                         strdup(manager->profiles[found].name) : NULL;
-                        profile_remove(manager, manager->profiles[found].name);
-
-                        // Reload from file
-                        if (load_profile_file(manager, filepath) == 0) {
-                            reloaded++;
-                            if (was_active) {
-                                // Re-activate the profile by name if it still exists
-                                if (old_name) {
-                                    profile_manager_switch(manager, old_name);
-                                }
-                            }
-                        } else {
-                            fprintf(stderr, "Error: Failed to reload %s (profile removed)\n", ev->name);
-                        }
-                        if (old_name) free(old_name);
-                    } else {
-                        // New file: load as new profile
-                        printf("Loading new profile from %s\n", ev->name);
-                        if (load_profile_file(manager, filepath) == 0) {
-                            reloaded++;
-                        }
-                    }
-                } else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
-                    // File deleted: remove profile
-                    printf("Removing profile from deleted file %s\n", ev->name);
-                    for (int i = 0; i < manager->profile_count; i++) {
-                        if (manager->profiles[i].source_file &&
-                            strcmp(manager->profiles[i].source_file, filepath) == 0) {
-                            profile_remove(manager, manager->profiles[i].name);
-                            reloaded++;
-                            break;
-                        }
-                    }
+            if (namelen >= 5 && strcasecmp(ev->name + namelen - 4, ".cfg") == 0 &&
+                profile_manager_reload_file(manager, ev->name) > 0) {
+                reloaded++;
+                if (manager->on_reload) {
+                    manager->on_reload(ev->name, manager->on_reload_data);
                 }
             }
         }
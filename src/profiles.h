@@ -31,6 +31,14 @@
 //
 // ============================================================================
 
+// Called when the configs handed out have gone stale, before any of them
+// is freed, so their users can move to the current ones
+typedef void (*profile_change_cb)(void* user_data);
+
+// Called with the name of each profile file hot reload has reloaded or
+// removed (relative to the profiles directory)
+typedef void (*profile_reload_cb)(const char* filename, void* user_data);
+
 // Profile definition
 typedef struct {
     char* name;                    // Profile name (shown in OSD on switch)
@@ -38,6 +46,7 @@ typedef struct {
     int priority;                  // Higher priority matched first (default: 0)
     char* source_file;             // Source .cfg file this profile was loaded from
     config_t* config;              // Overlay configuration (merged with default on switch)
+    config_t* bound_config;        // Merged config for keypads bound to this profile (lazy)
     char* key_descriptions[19];    // Per-button descriptions for this profile
     char* leader_descriptions[19]; // Per-button leader descriptions for this profile
     char* wheel_descriptions[32];  // Per-wheel-function descriptions
@@ -54,6 +63,11 @@ typedef struct {
     config_t* default_config;      // Default configuration (fallback when no profile matches
                                    // and no default profile is defined)
     config_t* merged_config;       // Merged config (default overlaid with active profile)
+    unsigned int generation;       // Bumped whenever a config handed out may be stale
+    profile_change_cb on_change;   // Told about generation changes (NULL = none)
+    void* on_change_data;
+    profile_reload_cb on_reload;   // Told about hot reloaded files (NULL = none)
+    void* on_reload_data;
     window_tracker_t* window_tracker;
     osd_state_t* osd;              // Reference to OSD for updating descriptions
     int debug;                     // Debug output level
@@ -71,6 +85,14 @@ void profile_manager_destroy(profile_manager_t* manager);
 // Initialize with shared X11 display
 int profile_manager_init(profile_manager_t* manager, void* display, osd_state_t* osd);
 
+// Set the callback run on every generation change (NULL = none)
+void profile_manager_set_change_callback(profile_manager_t* manager, profile_change_cb callback,
+                                         void* user_data);
+
+// Set the callback run for every file hot reload picks up (NULL = none)
+void profile_manager_set_reload_callback(profile_manager_t* manager, profile_reload_cb callback,
+                                         void* user_data);
+
 // Profile management
 int profile_add(profile_manager_t* manager, const char* name, const char* window_pattern,
                 const char* source_file, int priority);
@@ -98,6 +120,10 @@ profile_t* profile_manager_get_active(profile_manager_t* manager);
 // Get current active config (merged overlay of default + active profile)
 config_t* profile_manager_get_config(profile_manager_t* manager);
 
+// Merged config of a named profile, independent of the active window
+// (for keypads bound to a profile). Valid until the generation changes.
+config_t* profile_manager_get_profile_config(profile_manager_t* manager, const char* name);
+
 // Manual profile switching
 int profile_manager_switch(profile_manager_t* manager, const char* name);
 int profile_manager_switch_by_index(profile_manager_t* manager, int index);
@@ -123,4 +149,8 @@ void profile_manager_watch_stop(profile_manager_t* manager);
 // Returns number of profiles reloaded, 0 if none, -1 on error
 int profile_manager_check_reload(profile_manager_t* manager);
 
+// Reload the profile of one file in the profiles directory, or remove it if
+// the file is gone. Returns 1 if a profile changed, 0 if not, -1 on error.
+int profile_manager_reload_file(profile_manager_t* manager, const char* filename);
+
 #endif // PROFILES_H
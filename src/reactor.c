@@ -0,0 +1,326 @@
+#include "reactor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "utils.h"
+
+static void timer_unlink(reactor_timer_t* timer);
+static long timer_wait_ms(reactor_t* reactor, long now);
+static int timer_expire(reactor_t* reactor);
+
+// Helper: free sources that were removed while dispatching
+static void reap_removed(reactor_t* reactor) {
+    reactor_source_t** link = &reactor->sources;
+    while (*link) {
+        reactor_source_t* source = *link;
+        if (source->removed) {
+            *link = source->next;
+            free(source);
+        } else {
+            link = &source->next;
+        }
+    }
+}
+
+reactor_t* reactor_create(void) {
+    reactor_t* reactor = calloc(1, sizeof(reactor_t));
+    if (reactor == NULL) return NULL;
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epoll_fd < 0) {
+        fprintf(stderr, "Reactor: epoll_create1 failed: %s\n", strerror(errno));
+        free(reactor);
+        return NULL;
+    }
+
+    reactor->sources = NULL;
+    reactor->dispatching = 0;
+    reactor->wheel_ms = get_time_ms();
+    return reactor;
+}
+
+void reactor_destroy(reactor_t* reactor) {
+    if (reactor == NULL) return;
+
+    // Timers still armed are only unlinked; their owners free them
+    for (int i = 0; i < REACTOR_WHEEL_SLOTS; i++) {
+        while (reactor->wheel[i]) {
+            reactor_timer_t* timer = reactor->wheel[i];
+            timer_unlink(timer);
+            timer->armed = 0;
+        }
+    }
+    while (reactor->due) {
+        reactor_timer_t* timer = reactor->due;
+        timer_unlink(timer);
+        timer->expired = 0;
+        timer->armed = 0;
+    }
+
+    reactor_source_t* source = reactor->sources;
+    while (source) {
+        reactor_source_t* next = source->next;
+        free(source);
+        source = next;
+    }
+
+    close(reactor->epoll_fd);
+    free(reactor);
+}
+
+reactor_source_t* reactor_add_fd(reactor_t* reactor, int fd, unsigned int events,
+                                 reactor_fd_cb callback, void* user_data) {
+    if (reactor == NULL || fd < 0 || callback == NULL) return NULL;
+
+    reactor_source_t* source = calloc(1, sizeof(reactor_source_t));
+    if (source == NULL) return NULL;
+
+    source->fd = fd;
+    source->events = events;
+    source->callback = callback;
+    source->user_data = user_data;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = source;
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        fprintf(stderr, "Reactor: cannot watch fd %d: %s\n", fd, strerror(errno));
+        free(source);
+        return NULL;
+    }
+
+    source->next = reactor->sources;
+    reactor->sources = source;
+    return source;
+}
+
+int reactor_modify_fd(reactor_t* reactor, reactor_source_t* source, unsigned int events) {
+    if (reactor == NULL || source == NULL || source->removed) return -1;
+    if (source->events == events) return 0;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = source;
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, source->fd, &ev) < 0) {
+        return -1;
+    }
+    source->events = events;
+    return 0;
+}
+
+void reactor_remove_fd(reactor_t* reactor, reactor_source_t* source) {
+    if (reactor == NULL || source == NULL || source->removed) return;
+
+    // The fd may already be closed (and thus gone from the epoll set)
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+    source->removed = 1;
+
+    if (!reactor->dispatching) {
+        reap_removed(reactor);
+    }
+}
+
+reactor_source_t* reactor_find_fd(reactor_t* reactor, int fd) {
+    if (reactor == NULL) return NULL;
+    for (reactor_source_t* s = reactor->sources; s; s = s->next) {
+        if (s->fd == fd && !s->removed) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+int reactor_run_once(reactor_t* reactor, int timeout_ms) {
+    if (reactor == NULL) return -1;
+
+    // Wake up for the earliest timer deadline at the latest
+    long timer_ms = timer_wait_ms(reactor, get_time_ms());
+    if (timer_ms >= 0 && (timeout_ms < 0 || timer_ms < timeout_ms)) {
+        timeout_ms = (int)timer_ms;
+    }
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    int n = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    reactor->dispatching = 1;
+    for (int i = 0; i < n; i++) {
+        reactor_source_t* source = (reactor_source_t*)events[i].data.ptr;
+        // A callback earlier in this batch may have removed the source
+        if (source->removed) continue;
+        source->callback(source->fd, events[i].events, source->user_data);
+    }
+    reactor->dispatching = 0;
+
+    reap_removed(reactor);
+    return n + timer_expire(reactor);
+}
+
+// ============================================================================
+// Timers
+// ============================================================================
+
+static void timer_unlink(reactor_timer_t* timer) {
+    if (timer->link == NULL) return;
+    *timer->link = timer->next;
+    if (timer->next) timer->next->link = timer->link;
+    timer->next = NULL;
+    timer->link = NULL;
+}
+
+static void timer_push(reactor_timer_t** head, reactor_timer_t* timer) {
+    timer->next = *head;
+    if (*head) (*head)->link = &timer->next;
+    *head = timer;
+    timer->link = head;
+}
+
+// Put an armed timer into the slot of its deadline. Ticks up to wheel_ms
+// have been swept already, so a deadline there goes into the next tick.
+static void timer_insert(reactor_t* reactor, reactor_timer_t* timer) {
+    long tick = timer->deadline_ms > reactor->wheel_ms ? timer->deadline_ms : reactor->wheel_ms + 1;
+    timer_push(&reactor->wheel[tick & (REACTOR_WHEEL_SLOTS - 1)], timer);
+    if (!reactor->next_dirty && (reactor->timer_count == 0 || timer->deadline_ms < reactor->next_deadline_ms)) {
+        reactor->next_deadline_ms = timer->deadline_ms;
+    }
+    reactor->timer_count++;
+}
+
+// Milliseconds until the earliest deadline (-1 = no timer armed)
+static long timer_wait_ms(reactor_t* reactor, long now) {
+    if (reactor->timer_count == 0) return -1;
+
+    if (reactor->next_dirty) {
+        long next = -1;
+        for (int i = 0; i < REACTOR_WHEEL_SLOTS; i++) {
+            for (reactor_timer_t* t = reactor->wheel[i]; t; t = t->next) {
+                if (next < 0 || t->deadline_ms < next) next = t->deadline_ms;
+            }
+        }
+        reactor->next_deadline_ms = next;
+        reactor->next_dirty = 0;
+    }
+    return reactor->next_deadline_ms > now ? reactor->next_deadline_ms - now : 0;
+}
+
+// Move the timers due by now from the slots swept since the last call to
+// the due list
+static void timer_collect(reactor_t* reactor, long now, int slot) {
+    reactor_timer_t* t = reactor->wheel[slot];
+    while (t) {
+        reactor_timer_t* next = t->next;
+        if (t->deadline_ms <= now) {
+            timer_unlink(t);
+            timer_push(&reactor->due, t);
+            t->expired = 1;
+            reactor->timer_count--;
+            reactor->next_dirty = 1;
+        }
+        t = next;
+    }
+}
+
+// Run the callbacks of expired timers. Returns how many ran.
+static int timer_expire(reactor_t* reactor) {
+    long now = get_time_ms();
+
+    if (reactor->timer_count > 0 && now > reactor->wheel_ms) {
+        if (now - reactor->wheel_ms >= REACTOR_WHEEL_SLOTS) {
+            for (int i = 0; i < REACTOR_WHEEL_SLOTS; i++) {
+                timer_collect(reactor, now, i);
+            }
+        } else {
+            for (long tick = reactor->wheel_ms + 1; tick <= now; tick++) {
+                timer_collect(reactor, now, (int)(tick & (REACTOR_WHEEL_SLOTS - 1)));
+            }
+        }
+    }
+    if (now > reactor->wheel_ms) reactor->wheel_ms = now;
+
+    // A callback may arm, disarm or destroy any timer, this one included
+    int fired = 0;
+    while (reactor->due) {
+        reactor_timer_t* timer = reactor->due;
+        timer_unlink(timer);
+        timer->expired = 0;
+        if (timer->interval_ms > 0) {
+            timer->deadline_ms += timer->interval_ms;
+            // Missed periods are skipped, as timerfd expirations were
+            if (timer->deadline_ms <= now) timer->deadline_ms = now + timer->interval_ms;
+            timer_insert(reactor, timer);
+        } else {
+            timer->armed = 0;
+        }
+        timer->callback(timer->user_data);
+        fired++;
+    }
+    return fired;
+}
+
+reactor_timer_t* reactor_timer_create(reactor_t* reactor, reactor_timer_cb callback, void* user_data) {
+    if (reactor == NULL || callback == NULL) return NULL;
+
+    reactor_timer_t* timer = calloc(1, sizeof(reactor_timer_t));
+    if (timer == NULL) return NULL;
+
+    timer->reactor = reactor;
+    timer->callback = callback;
+    timer->user_data = user_data;
+    return timer;
+}
+
+void reactor_timer_destroy(reactor_timer_t* timer) {
+    if (timer == NULL) return;
+
+    reactor_timer_disarm(timer);
+    free(timer);
+}
+
+int reactor_timer_arm(reactor_timer_t* timer, long delay_ms, long interval_ms) {
+    if (timer == NULL) return -1;
+
+    reactor_timer_disarm(timer);
+    if (delay_ms < 0) delay_ms = 0;
+    timer->deadline_ms = get_time_ms() + delay_ms;
+    timer->interval_ms = interval_ms > 0 ? interval_ms : 0;
+    timer->armed = 1;
+    timer_insert(timer->reactor, timer);
+    return 0;
+}
+
+void reactor_timer_disarm(reactor_timer_t* timer) {
+    if (timer == NULL || !timer->armed) return;
+
+    // A timer on the due list was counted out of the wheel when it expired
+    if (!timer->expired) {
+        timer->reactor->timer_count--;
+        timer->reactor->next_dirty = 1;
+    }
+    timer_unlink(timer);
+    timer->expired = 0;
+    timer->armed = 0;
+}
+
+long reactor_timer_wait(reactor_t* reactor, int oneshot) {
+    if (reactor == NULL) return -1;
+
+    long now = get_time_ms();
+    if (!oneshot) return timer_wait_ms(reactor, now);
+
+    long next = -1;
+    for (int i = 0; i < REACTOR_WHEEL_SLOTS; i++) {
+        for (reactor_timer_t* t = reactor->wheel[i]; t; t = t->next) {
+            if (t->interval_ms == 0 && (next < 0 || t->deadline_ms < next)) next = t->deadline_ms;
+        }
+    }
+    if (next < 0) return -1;
+    return next > now ? next - now : 0;
+}
@@ -0,0 +1,97 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+// ============================================================================
+// EVENT REACTOR
+// ============================================================================
+//
+// Single epoll-based event loop. Every wakeup source of the driver (USB
+// pollfds, the X11 connection, inotify, timers) is registered here, so the
+// process sleeps in one epoll_wait() until something actually happens.
+//
+// Timers live in one CLOCK_MONOTONIC timer wheel inside the reactor, so
+// they are not affected by wall-clock jumps and arming one is not a system
+// call. epoll_wait() sleeps until the earliest deadline at most.
+//
+// ============================================================================
+
+// Maximum events collected per epoll_wait()
+#define REACTOR_MAX_EVENTS 16
+
+// Timer wheel: 1 ms ticks hashed into this many slots (a power of two).
+// A timer due more than one turn ahead stays in its slot for later turns.
+#define REACTOR_WHEEL_SLOTS 256
+
+// Callback for a readable/writable file descriptor (events = EPOLL* mask)
+typedef void (*reactor_fd_cb)(int fd, unsigned int events, void* user_data);
+
+// Callback for an expired timer
+typedef void (*reactor_timer_cb)(void* user_data);
+
+// Registered file descriptor
+typedef struct reactor_source {
+    int fd;
+    unsigned int events;
+    reactor_fd_cb callback;
+    void* user_data;
+    int removed;                  // Removed during dispatch, freed afterwards
+    struct reactor_source* next;
+} reactor_source_t;
+
+typedef struct reactor_timer reactor_timer_t;
+
+// Reactor state
+typedef struct {
+    int epoll_fd;
+    reactor_source_t* sources;
+    int dispatching;              // Inside reactor_run_once()
+
+    reactor_timer_t* wheel[REACTOR_WHEEL_SLOTS];  // Armed timers by deadline tick
+    reactor_timer_t* due;         // Expired, callbacks still to run
+    long wheel_ms;                // Ticks up to here have been expired
+    long next_deadline_ms;        // Earliest armed deadline (valid unless next_dirty)
+    int next_dirty;
+    int timer_count;              // Armed timers
+} reactor_t;
+
+// Timer
+struct reactor_timer {
+    reactor_t* reactor;
+    reactor_timer_t* next;        // In its wheel slot or the due list
+    reactor_timer_t** link;       // Pointer to this timer in that list (NULL = not listed)
+    long deadline_ms;             // CLOCK_MONOTONIC
+    long interval_ms;             // 0 = one-shot
+    int armed;
+    int expired;                  // On the due list
+    reactor_timer_cb callback;
+    void* user_data;
+};
+
+// Lifecycle functions
+reactor_t* reactor_create(void);
+void reactor_destroy(reactor_t* reactor);
+
+// File descriptor sources
+reactor_source_t* reactor_add_fd(reactor_t* reactor, int fd, unsigned int events,
+                                 reactor_fd_cb callback, void* user_data);
+int reactor_modify_fd(reactor_t* reactor, reactor_source_t* source, unsigned int events);
+void reactor_remove_fd(reactor_t* reactor, reactor_source_t* source);
+reactor_source_t* reactor_find_fd(reactor_t* reactor, int fd);
+
+// Wait up to timeout_ms (-1 = forever) and dispatch ready sources
+// Returns number of dispatched events, 0 on timeout, -1 on error
+int reactor_run_once(reactor_t* reactor, int timeout_ms);
+
+// Timers
+reactor_timer_t* reactor_timer_create(reactor_t* reactor, reactor_timer_cb callback, void* user_data);
+void reactor_timer_destroy(reactor_timer_t* timer);
+
+// Arm a timer to fire after delay_ms, then every interval_ms (0 = one-shot)
+int reactor_timer_arm(reactor_timer_t* timer, long delay_ms, long interval_ms);
+void reactor_timer_disarm(reactor_timer_t* timer);
+
+// Milliseconds until the earliest armed deadline, -1 if none. oneshot:
+// only one-shot timers count (a periodic one never runs out).
+long reactor_timer_wait(reactor_t* reactor, int oneshot);
+
+#endif // REACTOR_H
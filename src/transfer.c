@@ -0,0 +1,151 @@
+#include "transfer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Map a transfer completion status to the LIBUSB_ERROR_* code the
+// synchronous API would have returned
+static int status_to_error(enum libusb_transfer_status status) {
+    switch (status) {
+        case LIBUSB_TRANSFER_COMPLETED: return LIBUSB_SUCCESS;
+        case LIBUSB_TRANSFER_TIMED_OUT: return LIBUSB_ERROR_TIMEOUT;
+        case LIBUSB_TRANSFER_STALL:     return LIBUSB_ERROR_PIPE;
+        case LIBUSB_TRANSFER_NO_DEVICE: return LIBUSB_ERROR_NO_DEVICE;
+        case LIBUSB_TRANSFER_OVERFLOW:  return LIBUSB_ERROR_OVERFLOW;
+        case LIBUSB_TRANSFER_CANCELLED: return LIBUSB_ERROR_INTERRUPTED;
+        default:                        return LIBUSB_ERROR_IO;
+    }
+}
+
+// Completion callback for every in-flight transfer
+static void transfer_callback(struct libusb_transfer* transfer) {
+    transfer_engine_t* engine = (transfer_engine_t*)transfer->user_data;
+
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+        engine->in_flight--;
+        if (transfer->status != LIBUSB_TRANSFER_CANCELLED && engine->error == 0) {
+            engine->error = status_to_error(transfer->status);
+            if (engine->debug == 1) {
+                printf("Transfer failed: %s\n", libusb_error_name(engine->error));
+            }
+        }
+        return;
+    }
+
+    // Copy the report out before handing the buffer back to libusb so the
+    // next completion can land while this one is being dispatched
+    unsigned char data[REPORT_SIZE];
+    int length = transfer->actual_length;
+    if (length > REPORT_SIZE) length = REPORT_SIZE;
+    memcpy(data, transfer->buffer, length);
+    if (length < REPORT_SIZE) {
+        memset(data + length, 0, REPORT_SIZE - length);
+    }
+
+    if (engine->stopping) {
+        engine->in_flight--;
+    } else {
+        int err = libusb_submit_transfer(transfer);
+        if (err < 0) {
+            engine->in_flight--;
+            if (engine->error == 0) {
+                engine->error = err;
+            }
+        }
+    }
+
+    engine->completed++;
+    if (engine->on_report && length > 0) {
+        engine->on_report(data, length, engine->user_data);
+    }
+}
+
+transfer_engine_t* transfer_engine_create(libusb_device_handle* handle, unsigned char endpoint,
+                                          transfer_report_cb on_report, void* user_data, int debug) {
+    if (handle == NULL) return NULL;
+
+    transfer_engine_t* engine = calloc(1, sizeof(transfer_engine_t));
+    if (engine == NULL) return NULL;
+
+    engine->handle = handle;
+    engine->endpoint = endpoint;
+    engine->on_report = on_report;
+    engine->user_data = user_data;
+    engine->debug = debug;
+
+    for (int i = 0; i < TRANSFER_COUNT; i++) {
+        engine->transfers[i] = libusb_alloc_transfer(0);
+        if (engine->transfers[i] == NULL) {
+            transfer_engine_destroy(engine);
+            return NULL;
+        }
+        // Timeout 0: the transfer stays pending until the device reports
+        libusb_fill_interrupt_transfer(engine->transfers[i], handle, endpoint,
+                                       engine->buffers[i], REPORT_SIZE,
+                                       transfer_callback, engine, 0);
+    }
+
+    return engine;
+}
+
+void transfer_engine_destroy(transfer_engine_t* engine) {
+    if (engine == NULL) return;
+
+    // Transfers must not be freed while libusb still owns them
+    if (engine->in_flight > 0) {
+        fprintf(stderr, "Transfer engine destroyed with %d transfer(s) in flight\n",
+                engine->in_flight);
+        return;
+    }
+
+    for (int i = 0; i < TRANSFER_COUNT; i++) {
+        if (engine->transfers[i]) {
+            libusb_free_transfer(engine->transfers[i]);
+        }
+    }
+    free(engine);
+}
+
+int transfer_engine_start(transfer_engine_t* engine) {
+    if (engine == NULL) return LIBUSB_ERROR_INVALID_PARAM;
+
+    engine->stopping = 0;
+    engine->error = 0;
+
+    for (int i = 0; i < TRANSFER_COUNT; i++) {
+        int err = libusb_submit_transfer(engine->transfers[i]);
+        if (err < 0) {
+            if (engine->debug == 1) {
+                printf("Failed to submit transfer %d: %s\n", i, libusb_error_name(err));
+            }
+            engine->error = err;
+            return err;
+        }
+        engine->in_flight++;
+    }
+
+    if (engine->debug == 1) {
+        printf("Transfer engine: %d interrupt transfers in flight on endpoint 0x%02x\n",
+               engine->in_flight, engine->endpoint);
+    }
+    return 0;
+}
+
+void transfer_engine_stop(transfer_engine_t* engine, libusb_context* ctx) {
+    if (engine == NULL) return;
+
+    engine->stopping = 1;
+    for (int i = 0; i < TRANSFER_COUNT; i++) {
+        // Fails harmlessly for transfers that already completed
+        libusb_cancel_transfer(engine->transfers[i]);
+    }
+
+    // Cancellation is asynchronous: keep handling events until every
+    // transfer has come back through the callback
+    while (engine->in_flight > 0) {
+        struct timeval tv = {0, 100000};
+        if (libusb_handle_events_timeout_completed(ctx, &tv, NULL) < 0) {
+            break;
+        }
+    }
+}
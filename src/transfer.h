@@ -0,0 +1,44 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <libusb-1.0/libusb.h>
+
+// Number of interrupt transfers kept submitted at all times.
+// While one completion is being dispatched the others keep the endpoint
+// polled, so fast wheel spins are not lost between reads.
+#define TRANSFER_COUNT 4
+
+// Size of a single KD100 input report
+#define REPORT_SIZE 40
+
+// Report callback: invoked from inside libusb event handling for every
+// completed transfer (after it has already been resubmitted)
+typedef void (*transfer_report_cb)(const unsigned char* data, int length, void* user_data);
+
+// Asynchronous interrupt transfer engine
+typedef struct {
+    libusb_device_handle* handle;
+    unsigned char endpoint;
+    struct libusb_transfer* transfers[TRANSFER_COUNT];
+    unsigned char buffers[TRANSFER_COUNT][REPORT_SIZE];
+    int in_flight;                // Transfers currently owned by libusb
+    int error;                    // First fatal error as a LIBUSB_ERROR_* code (0 = none)
+    int stopping;                 // Set while cancelling, suppresses resubmission
+    unsigned long completed;      // Reports delivered
+    transfer_report_cb on_report;
+    void* user_data;
+    int debug;
+} transfer_engine_t;
+
+// Lifecycle functions
+transfer_engine_t* transfer_engine_create(libusb_device_handle* handle, unsigned char endpoint,
+                                          transfer_report_cb on_report, void* user_data, int debug);
+void transfer_engine_destroy(transfer_engine_t* engine);
+
+// Submit all transfers. Returns 0 on success or a LIBUSB_ERROR_* code
+int transfer_engine_start(transfer_engine_t* engine);
+
+// Cancel outstanding transfers and wait until libusb has returned all of them
+void transfer_engine_stop(transfer_engine_t* engine, libusb_context* ctx);
+
+#endif // TRANSFER_H
@@ -0,0 +1,65 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <libusb-1.0/libusb.h>
+#include "config.h"
+#include "dispatch.h"
+#include "reactor.h"
+
+// ============================================================================
+// TRANSPORTS
+// ============================================================================
+//
+// A transport finds keypads and feeds their reports into the dispatcher.
+// The device loop only talks to transports through transport_ops_t:
+//
+//   libusb     Interrupt transfers (default)
+//   hidraw     /dev/hidraw* when hid_uclogic owns the device
+//   simulated  Generated key, wheel and chord traffic over socketpairs
+//
+// Report sources are registered with the shared reactor, so every
+// transport is serviced by the same wait in the device loop.
+//
+// ============================================================================
+
+typedef struct transport transport_t;
+
+typedef struct {
+    const char* name;
+
+    // Start driving keypads that are not driven yet.
+    // Returns -1 on a fatal error.
+    int (*scan)(transport_t* transport);
+
+    // Drop keypads that failed or went away after a wait.
+    // Returns -1 if the driver should stop.
+    int (*reap)(transport_t* transport);
+
+    // Bound the next wait in ms (-1 = no bound), and service the
+    // transport after it. Both may be NULL.
+    int (*next_timeout)(transport_t* transport);
+    void (*after_wait)(transport_t* transport);
+
+    // Release every keypad and free the transport
+    void (*destroy)(transport_t* transport);
+} transport_ops_t;
+
+// Common transport state
+struct transport {
+    const transport_ops_t* ops;
+    dispatcher_t* dispatcher;
+    reactor_t* reactor;
+    int debug;
+    int keypads;       // Keypads currently driven
+    int arrived;       // A device showed up; scan again
+    int hotplug;       // Arrivals are signalled, no need to poll
+};
+
+// Constructors (NULL on failure)
+transport_t* usb_transport_create(libusb_context* ctx, config_t* config, dispatcher_t* dispatcher,
+                                  reactor_t* reactor, int debug, int accept);
+transport_t* hidraw_transport_create(dispatcher_t* dispatcher, reactor_t* reactor, int debug);
+transport_t* sim_transport_create(const char* spec, dispatcher_t* dispatcher,
+                                  reactor_t* reactor, int debug);
+
+#endif // TRANSPORT_H
@@ -0,0 +1,140 @@
+#include "transport.h"
+#include "compat.h"
+#include "transfer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+// Keypad driven via hidraw (when hid_uclogic owns the device)
+typedef struct {
+    transport_t base;
+    int fd;
+    reactor_source_t* source;
+    keypad_t* keypad;
+    int error;                       // hidraw node failed or went away
+} hidraw_transport_t;
+
+// hidraw node readable: every read() returns exactly one input report
+static void on_hidraw_ready(int fd, unsigned int events, void* user_data) {
+    hidraw_transport_t* ht = (hidraw_transport_t*)user_data;
+    unsigned char data[REPORT_SIZE];
+
+    for (;;) {
+        ssize_t bytes_read = read(fd, data, sizeof(data));
+        if (bytes_read > 0) {
+            dispatcher_report(data, (int)bytes_read, ht->keypad);
+            continue;
+        }
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EINTR)) {
+            break;
+        }
+        // 0 or ENODEV/EIO: the device was unplugged
+        if (ht->base.debug == 1) {
+            printf("hidraw read failed: %s\n", bytes_read < 0 ? strerror(errno) : "EOF");
+        }
+        ht->error = 1;
+        return;
+    }
+
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        ht->error = 1;
+    }
+}
+
+static void stop_hidraw_keypad(hidraw_transport_t* ht) {
+    if (ht->error)
+        printf("\nDEVICE DISCONNECTED\n");
+
+    reactor_remove_fd(ht->base.reactor, ht->source);
+    close(ht->fd);
+    dispatcher_detach(ht->base.dispatcher, ht->keypad);
+
+    ht->fd = -1;
+    ht->source = NULL;
+    ht->keypad = NULL;
+    ht->base.keypads = 0;
+}
+
+// Open the keypad through hidraw (bypasses hid_uclogic)
+static int hidraw_scan(transport_t* transport) {
+    hidraw_transport_t* ht = (hidraw_transport_t*)transport;
+
+    if (ht->fd >= 0) return 0;
+
+    int fd = try_hidraw_access();
+    if (fd < 0) {
+        printf("hidraw access failed, trying libusb with workarounds...\n");
+        return 0;
+    }
+
+    printf("Using hidraw interface (bypassing hid_uclogic)\n");
+
+    keypad_t* kp = dispatcher_attach(transport->dispatcher, NULL);
+    reactor_source_t* source = NULL;
+    if (kp) {
+        // Reports are decoded by the same pipeline as the libusb path;
+        // the reactor wakes us when the kernel has one queued
+        source = reactor_add_fd(transport->reactor, fd, EPOLLIN, on_hidraw_ready, ht);
+    }
+    if (source == NULL) {
+        dispatcher_detach(transport->dispatcher, kp);
+        close(fd);
+        return 0;
+    }
+
+    ht->fd = fd;
+    ht->source = source;
+    ht->keypad = kp;
+    ht->error = 0;
+    transport->keypads = 1;
+
+    if (transport->debug == 0) {
+        system("clear");
+    }
+    printf("Starting driver via hidraw...\n");
+    printf("Driver is running!\n");
+    return 0;
+}
+
+// A failed node is closed; the next scan looks for it again
+static int hidraw_reap(transport_t* transport) {
+    hidraw_transport_t* ht = (hidraw_transport_t*)transport;
+
+    if (ht->fd >= 0 && ht->error) {
+        stop_hidraw_keypad(ht);
+    }
+    return 0;
+}
+
+static void hidraw_destroy(transport_t* transport) {
+    hidraw_transport_t* ht = (hidraw_transport_t*)transport;
+
+    if (ht->fd >= 0) {
+        stop_hidraw_keypad(ht);
+    }
+    free(ht);
+}
+
+static const transport_ops_t hidraw_transport_ops = {
+    "hidraw",
+    hidraw_scan,
+    hidraw_reap,
+    NULL,
+    NULL,
+    hidraw_destroy
+};
+
+transport_t* hidraw_transport_create(dispatcher_t* dispatcher, reactor_t* reactor, int debug) {
+    hidraw_transport_t* ht = calloc(1, sizeof(hidraw_transport_t));
+    if (ht == NULL) return NULL;
+
+    ht->base.ops = &hidraw_transport_ops;
+    ht->base.dispatcher = dispatcher;
+    ht->base.reactor = reactor;
+    ht->base.debug = debug;
+    ht->fd = -1;
+    return &ht->base;
+}
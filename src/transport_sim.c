@@ -0,0 +1,321 @@
+#include "transport.h"
+#include "handler.h"
+#include "transfer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// Simulated traffic. Spec: comma separated key=value pairs, e.g.
+//   rate=5000,count=100000,keypads=2,keys=70,wheel=20,chords=10
+typedef struct {
+    long rate;           // Events per second (0 = as fast as possible)
+    long count;          // Events to generate (0 = endless)
+    int keypads;         // Simulated keypads
+    int keys;            // Relative weight of single key presses
+    int wheel;           // Relative weight of wheel ticks
+    int chords;          // Relative weight of two-button chords
+    unsigned int seed;
+} sim_spec_t;
+
+typedef struct {
+    int fd;
+    reactor_source_t* source;
+    keypad_t* keypad;
+    int done;            // Generator closed its end
+    long reports;
+} sim_keypad_t;
+
+typedef struct {
+    transport_t base;
+    sim_spec_t spec;
+    pid_t generator;
+    sim_keypad_t pads[MAX_KEYPADS];
+    int started;
+    struct timespec start;
+} sim_transport_t;
+
+static int parse_spec(const char* text, sim_spec_t* spec) {
+    spec->rate = 1000;
+    spec->count = 10000;
+    spec->keypads = 1;
+    spec->keys = 70;
+    spec->wheel = 20;
+    spec->chords = 10;
+    spec->seed = 1;
+
+    while (text && *text) {
+        char key[16];
+        long value;
+        int used;
+        if (sscanf(text, "%15[a-z]=%ld%n", key, &value, &used) != 2 || value < 0) {
+            return -1;
+        }
+
+        if (strcmp(key, "rate") == 0) spec->rate = value;
+        else if (strcmp(key, "count") == 0) spec->count = value;
+        else if (strcmp(key, "keypads") == 0) spec->keypads = (int)value;
+        else if (strcmp(key, "keys") == 0) spec->keys = (int)value;
+        else if (strcmp(key, "wheel") == 0) spec->wheel = (int)value;
+        else if (strcmp(key, "chords") == 0) spec->chords = (int)value;
+        else if (strcmp(key, "seed") == 0) spec->seed = (unsigned int)value;
+        else return -1;
+
+        text += used;
+        if (*text == ',') text++;
+        else if (*text != '\0') return -1;
+    }
+
+    if (spec->keypads < 1 || spec->keypads > MAX_KEYPADS) return -1;
+    if (spec->keys + spec->wheel + spec->chords <= 0) return -1;
+    return 0;
+}
+
+// ============================================================================
+// Generator (child process)
+// ============================================================================
+
+// Report bytes carrying a button (see decode.h)
+static void set_button(unsigned char* report, int button) {
+    report[4 + button / 8] |= (unsigned char)(1u << (button % 8));
+}
+
+static int send_report(int fd, const unsigned char* report) {
+    while (send(fd, report, REPORT_SIZE, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+static void run_generator(const sim_spec_t* spec, const int* fds) {
+    unsigned char press[REPORT_SIZE], release[REPORT_SIZE];
+    unsigned int seed = spec->seed;
+    int total = spec->keys + spec->wheel + spec->chords;
+    struct timespec next;
+
+    memset(release, 0, sizeof(release));
+    release[0] = 1;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (long i = 0; spec->count == 0 || i < spec->count; i++) {
+        int fd = fds[i % spec->keypads];
+        int pick = rand_r(&seed) % total;
+
+        memset(press, 0, sizeof(press));
+        press[0] = 1;
+
+        if (pick < spec->keys) {
+            set_button(press, rand_r(&seed) % 19);
+        } else if (pick < spec->keys + spec->wheel) {
+            press[1] = 241;
+            press[5] = (rand_r(&seed) & 1) ? 1 : 2;
+        } else {
+            // Two buttons of the same group, as the keypad reports them
+            int group = rand_r(&seed) % 2;
+            int a = rand_r(&seed) % 8;
+            int b = (a + 1 + rand_r(&seed) % 7) % 8;
+            set_button(press, group * 8 + a);
+            set_button(press, group * 8 + b);
+        }
+
+        if (send_report(fd, press) < 0) break;
+        if (press[1] != 241 && send_report(fd, release) < 0) break;
+
+        // Pace against absolute deadlines so sleep overshoot doesn't accumulate
+        if (spec->rate > 0) {
+            next.tv_nsec += 1000000000L / spec->rate;
+            while (next.tv_nsec >= 1000000000L) {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+        }
+    }
+}
+
+// ============================================================================
+// Transport
+// ============================================================================
+
+static void on_sim_ready(int fd, unsigned int events, void* user_data) {
+    sim_keypad_t* pad = (sim_keypad_t*)user_data;
+    unsigned char data[REPORT_SIZE];
+    (void)events;
+
+    for (;;) {
+        ssize_t bytes_read = recv(fd, data, sizeof(data), 0);
+        if (bytes_read > 0) {
+            dispatcher_report(data, (int)bytes_read, pad->keypad);
+            pad->reports++;
+            continue;
+        }
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EINTR)) {
+            break;
+        }
+        // EOF: the generator finished
+        pad->done = 1;
+        return;
+    }
+}
+
+static void stop_sim(sim_transport_t* simt) {
+    for (int i = 0; i < simt->spec.keypads; i++) {
+        sim_keypad_t* pad = &simt->pads[i];
+        if (pad->source) reactor_remove_fd(simt->base.reactor, pad->source);
+        if (pad->fd >= 0) close(pad->fd);
+        dispatcher_detach(simt->base.dispatcher, pad->keypad);
+        pad->source = NULL;
+        pad->fd = -1;
+        pad->keypad = NULL;
+    }
+
+    if (simt->generator > 0) {
+        kill(simt->generator, SIGTERM);
+        waitpid(simt->generator, NULL, 0);
+        simt->generator = 0;
+    }
+    simt->base.keypads = 0;
+}
+
+// Start the generator once; one socketpair per simulated keypad.
+// SOCK_SEQPACKET keeps report boundaries, like a hidraw node.
+static int sim_scan(transport_t* transport) {
+    sim_transport_t* simt = (sim_transport_t*)transport;
+    int child_fds[MAX_KEYPADS];
+
+    if (simt->started) return 0;
+    simt->started = 1;
+
+    for (int i = 0; i < simt->spec.keypads; i++) {
+        int pair[2];
+        sim_keypad_t* pad = &simt->pads[i];
+
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) < 0) {
+            printf("Simulation: socketpair failed: %s\n", strerror(errno));
+            stop_sim(simt);
+            return -1;
+        }
+        fcntl(pair[0], F_SETFL, fcntl(pair[0], F_GETFL) | O_NONBLOCK);
+        pad->fd = pair[0];
+        child_fds[i] = pair[1];
+
+        char port[32];
+        snprintf(port, sizeof(port), "sim-%d", i);
+        pad->keypad = dispatcher_attach(transport->dispatcher, port);
+        if (pad->keypad) {
+            pad->source = reactor_add_fd(transport->reactor, pad->fd, EPOLLIN, on_sim_ready, pad);
+        }
+        if (pad->source == NULL) {
+            for (int j = 0; j <= i; j++) close(child_fds[j]);
+            stop_sim(simt);
+            return -1;
+        }
+    }
+
+    fflush(stdout);
+    simt->generator = fork();
+    if (simt->generator == 0) {
+        // The generator must see EPIPE once the driver closes its ends,
+        // and must not inherit signals the driver handles via signalfd
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        for (int i = 0; i < simt->spec.keypads; i++) {
+            close(simt->pads[i].fd);
+        }
+        run_generator(&simt->spec, child_fds);
+        _exit(0);
+    }
+    for (int i = 0; i < simt->spec.keypads; i++) {
+        close(child_fds[i]);
+    }
+    if (simt->generator < 0) {
+        printf("Simulation: fork failed: %s\n", strerror(errno));
+        stop_sim(simt);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &simt->start);
+    transport->keypads = simt->spec.keypads;
+    printf("Simulating %d keypad(s): ", simt->spec.keypads);
+    if (simt->spec.count > 0) {
+        printf("%ld events", simt->spec.count);
+    } else {
+        printf("endless events");
+    }
+    if (simt->spec.rate > 0) {
+        printf(" at %ld/s\n", simt->spec.rate);
+    } else {
+        printf(" as fast as possible\n");
+    }
+    return 0;
+}
+
+// Stop the driver once every generated report has been dispatched
+static int sim_reap(transport_t* transport) {
+    sim_transport_t* simt = (sim_transport_t*)transport;
+    long reports = 0;
+
+    for (int i = 0; i < simt->spec.keypads; i++) {
+        if (!simt->pads[i].done) return 0;
+        reports += simt->pads[i].reports;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - simt->start.tv_sec) + (now.tv_nsec - simt->start.tv_nsec) / 1e9;
+
+    printf("Simulation finished: %ld reports in %.3f s (%.0f reports/s)\n",
+           reports, elapsed, elapsed > 0 ? reports / elapsed : 0.0);
+    if (handler_get_sink() == HANDLER_SINK_COUNT) {
+        printf("Actions dispatched: %ld\n", handler_get_count());
+    }
+
+    stop_sim(simt);
+    return -1;
+}
+
+static void sim_destroy(transport_t* transport) {
+    sim_transport_t* simt = (sim_transport_t*)transport;
+
+    stop_sim(simt);
+    free(simt);
+}
+
+static const transport_ops_t sim_transport_ops = {
+    "simulated",
+    sim_scan,
+    sim_reap,
+    NULL,
+    NULL,
+    sim_destroy
+};
+
+transport_t* sim_transport_create(const char* spec, dispatcher_t* dispatcher,
+                                  reactor_t* reactor, int debug) {
+    sim_transport_t* simt = calloc(1, sizeof(sim_transport_t));
+    if (simt == NULL) return NULL;
+
+    if (parse_spec(spec, &simt->spec) < 0) {
+        printf("Invalid simulation spec '%s'\n", spec);
+        printf("Use key=value pairs: rate, count, keypads, keys, wheel, chords, seed\n");
+        free(simt);
+        return NULL;
+    }
+
+    simt->base.ops = &sim_transport_ops;
+    simt->base.dispatcher = dispatcher;
+    simt->base.reactor = reactor;
+    simt->base.debug = debug;
+    for (int i = 0; i < MAX_KEYPADS; i++) {
+        simt->pads[i].fd = -1;
+    }
+    return &simt->base;
+}
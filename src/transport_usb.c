@@ -0,0 +1,477 @@
+#include "transport.h"
+#include "device.h"
+#include "leader.h"
+#include "transfer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <poll.h>
+
+// A keypad driven through libusb
+typedef struct {
+    libusb_device* dev;
+    libusb_device_handle* handle;
+    transfer_engine_t* engine;
+    int interfaces;                  // Claimed interfaces
+    int error;                       // Start-up error (LIBUSB_ERROR_*)
+    int left;                        // Unplugged (hotplug event)
+    keypad_t* keypad;                // Dispatcher slot
+} usb_keypad_t;
+
+typedef struct {
+    transport_t base;
+    libusb_context* ctx;
+    config_t* config;
+    int accept;                      // -a: use every match without prompting
+    libusb_hotplug_callback_handle hotplug_handle;
+    usb_keypad_t usb[MAX_KEYPADS];
+    int usb_count;
+} usb_transport_t;
+
+// libusb pollfd readable: reap completed transfers (runs dispatcher_report)
+static void on_usb_ready(int fd, unsigned int events, void* user_data) {
+    (void)fd;
+    (void)events;
+    usb_transport_t* ut = (usb_transport_t*)user_data;
+    struct timeval zero = {0, 0};
+    libusb_handle_events_timeout_completed(ut->ctx, &zero, NULL);
+}
+
+static void on_usb_pollfd_added(int fd, short events, void* user_data) {
+    usb_transport_t* ut = (usb_transport_t*)user_data;
+    unsigned int mask = 0;
+    if (events & POLLIN) mask |= EPOLLIN;
+    if (events & POLLOUT) mask |= EPOLLOUT;
+    reactor_add_fd(ut->base.reactor, fd, mask, on_usb_ready, ut);
+}
+
+static void on_usb_pollfd_removed(int fd, void* user_data) {
+    usb_transport_t* ut = (usb_transport_t*)user_data;
+    reactor_remove_fd(ut->base.reactor, reactor_find_fd(ut->base.reactor, fd));
+}
+
+// Hotplug event for a KD100 (filtered on VID/PID by libusb). Only records
+// the event; opening and closing happens in the device loop.
+static int on_hotplug(libusb_context* ctx, libusb_device* dev,
+                      libusb_hotplug_event event, void* user_data) {
+    (void)ctx;
+    usb_transport_t* ut = (usb_transport_t*)user_data;
+
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+        ut->base.arrived = 1;
+        if (ut->base.debug == 1) {
+            printf("Hotplug: device arrived (Bus: %03d Device: %03d)\n",
+                   libusb_get_bus_number(dev), libusb_get_device_address(dev));
+        }
+    } else if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT) {
+        for (int i = 0; i < ut->usb_count; i++) {
+            if (ut->usb[i].dev == dev) {
+                ut->usb[i].left = 1;
+            }
+        }
+        if (ut->base.debug == 1) {
+            printf("Hotplug: device left (Bus: %03d Device: %03d)\n",
+                   libusb_get_bus_number(dev), libusb_get_device_address(dev));
+        }
+    }
+    return 0;  // Keep the callback registered
+}
+
+// USB port path of a device, e.g. "1-4.2" (bus, then port chain)
+static void device_port_path(libusb_device* dev, char* buf, size_t size) {
+    uint8_t ports[8];
+    int count = libusb_get_port_numbers(dev, ports, sizeof(ports));
+    int len = snprintf(buf, size, "%d", libusb_get_bus_number(dev));
+
+    for (int i = 0; i < count && len < (int)size; i++) {
+        len += snprintf(buf + len, size - len, i == 0 ? "-%d" : ".%d", ports[i]);
+    }
+}
+
+static int usb_keypad_is_open(usb_transport_t* ut, libusb_device* dev) {
+    for (int i = 0; i < ut->usb_count; i++) {
+        if (ut->usb[i].dev == dev) return 1;
+    }
+    return 0;
+}
+
+// Claim the interfaces of an opened keypad and start its transfers.
+// Takes ownership of the handle.
+static void start_usb_keypad(usb_transport_t* ut, libusb_device* dev, libusb_device_handle* handle) {
+    config_t* config = ut->config;
+    int debug = ut->base.debug;
+    struct libusb_config_descriptor* desc;
+    int interfaces = 0;
+    int err;
+
+    if (ut->usb_count >= MAX_KEYPADS) {
+        printf("Too many keypads (max %d), ignoring device\n", MAX_KEYPADS);
+        libusb_close(handle);
+        return;
+    }
+
+    if (debug == 0 && ut->usb_count == 0) {
+        system("clear");
+    }
+    printf("Starting driver via libusb...\n");
+
+    if (libusb_get_config_descriptor(dev, 0, &desc) == 0) {
+        interfaces = desc->bNumInterfaces;
+        libusb_free_config_descriptor(desc);
+    }
+
+    if (config->enable_uclogic) {
+        libusb_set_auto_detach_kernel_driver(handle, 1);
+        if (debug == 1)
+            printf("Using auto-detach (hid_uclogic compatible mode)\n");
+    } else {
+        for (int x = 0; x < interfaces; x++) {
+            if (libusb_kernel_driver_active(handle, x) == 1) {
+                printf("Detaching kernel driver from interface %d...\n", x);
+                err = libusb_detach_kernel_driver(handle, x);
+                if (err != 0 && debug == 1) {
+                    printf("Failed to detach kernel driver: %s\n", libusb_error_name(err));
+                }
+            }
+        }
+    }
+
+    if (debug == 1)
+        printf("Claiming interfaces... \n");
+
+    for (int x = 0; x < interfaces; x++) {
+        err = libusb_claim_interface(handle, x);
+        if (err != LIBUSB_SUCCESS && debug == 1)
+            printf("Failed to claim interface %d: %s\n", x, libusb_error_name(err));
+    }
+
+    char port[32];
+    device_port_path(dev, port, sizeof(port));
+
+    usb_keypad_t* usb = &ut->usb[ut->usb_count++];
+    memset(usb, 0, sizeof(usb_keypad_t));
+    usb->dev = dev;
+    usb->handle = handle;
+    usb->interfaces = interfaces;
+    usb->keypad = dispatcher_attach(ut->base.dispatcher, port);
+
+    if (usb->keypad == NULL) {
+        usb->error = LIBUSB_ERROR_NO_MEM;
+        return;
+    }
+
+    if (ut->usb_count == 1) {
+        printf("Driver is running!\n");
+        printf("Enhanced Leader Key System v1.7.2\n");
+        printf("Mode: %s | Timeout: %d ms\n",
+               leader_mode_to_string(config->leader.mode), config->leader.timeout_ms);
+        printf("Wheel Mode: %s", config->wheel_mode == WHEEL_MODE_SEQUENTIAL ? "sequential" : "sets");
+        if (config->wheel_mode == WHEEL_MODE_SETS) {
+            printf(" | Click Timeout: %d ms", config->wheel_click_timeout_ms);
+        }
+        printf("\n");
+        printf("Press leader button first, then eligible buttons for combinations.\n");
+    }
+    printf("Keypad %d connected (port %s)\n", usb->keypad->id, port);
+
+    // Keep several interrupt transfers in flight; reports are
+    // dispatched from the completion callback
+    usb->engine = transfer_engine_create(handle, 0x81, dispatcher_report, usb->keypad, debug);
+    usb->error = usb->engine ? transfer_engine_start(usb->engine) : LIBUSB_ERROR_NO_MEM;
+}
+
+// Current error of a libusb keypad (0 while it is healthy)
+static int usb_keypad_error(usb_keypad_t* usb) {
+    if (usb->error < 0) return usb->error;
+    if (usb->engine && usb->engine->error != 0) return usb->engine->error;
+    if (usb->left) return LIBUSB_ERROR_NO_DEVICE;
+    return 0;
+}
+
+// Stop a libusb keypad, release it and free its slot
+static void stop_usb_keypad(usb_transport_t* ut, int index, int err) {
+    usb_keypad_t* usb = &ut->usb[index];
+    int debug = ut->base.debug;
+
+    if (err == LIBUSB_ERROR_PIPE)
+        printf("\nPIPE ERROR\n");
+    if (err == LIBUSB_ERROR_NO_DEVICE)
+        printf("\nDEVICE DISCONNECTED\n");
+    if (err == LIBUSB_ERROR_OVERFLOW)
+        printf("\nOVERFLOW ERROR\n");
+    if (err == LIBUSB_ERROR_INVALID_PARAM)
+        printf("\nINVALID PARAMETERS\n");
+    if (err == -1)
+        printf("\nDEVICE IS ALREADY IN USE\n");
+    if (debug == 1 && err != 0) {
+        printf("Unable to retrieve data: %d\n", err);
+    }
+
+    if (usb->engine) {
+        transfer_engine_stop(usb->engine, ut->ctx);
+        transfer_engine_destroy(usb->engine);
+    }
+
+    // Cleanup
+    for (int x = 0; x < usb->interfaces; x++) {
+        if (debug == 1) {
+            printf("Releasing interface %d...\n", x);
+        }
+        libusb_release_interface(usb->handle, x);
+    }
+    printf("Closing device...\n");
+    libusb_close(usb->handle);
+    dispatcher_detach(ut->base.dispatcher, usb->keypad);
+
+    ut->usb[index] = ut->usb[--ut->usb_count];
+}
+
+// Open every matching keypad that is not driven yet. With -a all of them
+// are used; otherwise the user picks one. Returns -1 on a fatal error.
+static int scan_devices(usb_transport_t* ut) {
+    libusb_context* ctx = ut->ctx;
+    config_t* config = ut->config;
+    int debug = ut->base.debug;
+    libusb_device** devs;
+    libusb_device* candidates[MAX_KEYPADS];
+    int count = 0, found = 0, started = 0;
+
+    int err = libusb_get_device_list(ctx, &devs);
+    if (err < 0) {
+        printf("Unable to retrieve USB devices. Exiting...\n");
+        return -1;
+    }
+
+    libusb_device* dev;
+    for (int d = 0; (dev = devs[d]) != NULL; d++) {
+        struct libusb_device_descriptor devDesc;
+        err = libusb_get_device_descriptor(dev, &devDesc);
+
+        if (err < 0) {
+            if (debug > 0) {
+                printf("Unable to retrieve info from device #%d. Ignoring...\n", d);
+            }
+        } else if (devDesc.idVendor == DEVICE_VID && devDesc.idProduct == DEVICE_PID &&
+                   !usb_keypad_is_open(ut, dev) && count < MAX_KEYPADS) {
+            candidates[count++] = dev;
+        }
+    }
+
+    if (ut->accept == 1) {
+        for (int i = 0; i < count; i++) {
+            libusb_device_handle* handle = NULL;
+            dev = candidates[i];
+
+            if (getuid() != 0) {
+                err = libusb_open(dev, &handle);
+                if (err < 0) {
+                    if (err == LIBUSB_ERROR_ACCESS && !config->enable_uclogic) {
+                        printf("\nPermission denied - hid_uclogic may be claiming the device.\n");
+                        printf("Try: sudo rmmod hid_uclogic\n");
+                        printf("Or set enable_uclogic: true in config\n");
+                    }
+                    if (err == LIBUSB_ERROR_ACCESS) {
+                        printf("Error: Permission denied\n");
+                        libusb_free_device_list(devs, 1);
+                        return -1;
+                    }
+                    continue;
+                }
+                if (debug > 0) {
+                    printf("\nUsing: %04x:%04x (Bus: %03d Device: %03d)\n",
+                           DEVICE_VID, DEVICE_PID,
+                           libusb_get_bus_number(dev),
+                           libusb_get_device_address(dev));
+                }
+            } else {
+                unsigned char info[200] = "";
+                struct libusb_device_descriptor devDesc;
+                libusb_get_device_descriptor(dev, &devDesc);
+
+                err = libusb_open(dev, &handle);
+                if (err < 0) {
+                    printf("\nUnable to open device. Error: %d\n", err);
+                    continue;
+                }
+                libusb_get_string_descriptor_ascii(handle, devDesc.iProduct, info, 200);
+                if (debug > 0) {
+                    printf("\n#%d | %04x:%04x : %s\n", i, DEVICE_VID, DEVICE_PID, (char*)info);
+                }
+                if (strlen((char*)info) != 0 && strcmp("Huion Tablet_KD100", (char*)info) != 0) {
+                    libusb_close(handle);
+                    found++;
+                    continue;
+                }
+            }
+
+            start_usb_keypad(ut, dev, handle);
+            started++;
+        }
+
+        if (found > 0 && started == 0 && ut->usb_count == 0) {
+            printf("Error: Found device does not appear to be the keydial\n");
+            printf("Try running without the -a flag\n");
+            libusb_free_device_list(devs, 1);
+            return -1;
+        }
+    } else if (count > 0 && ut->usb_count == 0) {
+        // Interactive selection drives a single keypad
+        libusb_device_handle* handle = NULL;
+        int in = -1;
+        while (in == -1) {
+            char buf[64];
+            printf("\n");
+            system("lsusb");
+            printf("\n");
+            for (int d = 0; d < count; d++) {
+                printf("%d) %04x:%04x (Bus: %03d Device: %03d)\n", d,
+                       DEVICE_VID, DEVICE_PID,
+                       libusb_get_bus_number(candidates[d]),
+                       libusb_get_device_address(candidates[d]));
+            }
+            printf("Select a device to use: ");
+            fflush(stdout);
+            fgets(buf, 10, stdin);
+            in = atoi(buf);
+            if (in >= count || in < 0) {
+                in = -1;
+            }
+            system("clear");
+        }
+        err = libusb_open(candidates[in], &handle);
+        if (err < 0) {
+            printf("Unable to open device. Error: %d\n", err);
+            if (err == LIBUSB_ERROR_ACCESS) {
+                printf("Error: Permission denied\n");
+                if (!config->enable_uclogic) {
+                    printf("hid_uclogic may be claiming the device.\n");
+                    printf("Solutions:\n");
+                    printf("  1. Unload: sudo rmmod hid_uclogic\n");
+                    printf("  2. Set enable_uclogic: true in config\n");
+                    printf("  3. Run driver as root (not recommended)\n");
+                }
+                libusb_free_device_list(devs, 1);
+                return -1;
+            }
+        } else {
+            start_usb_keypad(ut, candidates[in], handle);
+        }
+    }
+
+    // Open handles keep their devices referenced
+    libusb_free_device_list(devs, 1);
+    return 0;
+}
+
+static int usb_scan(transport_t* transport) {
+    usb_transport_t* ut = (usb_transport_t*)transport;
+    int err = scan_devices(ut);
+    transport->keypads = ut->usb_count;
+    return err;
+}
+
+// Drop keypads whose transfers failed or that were unplugged.
+// Errors other than a disconnect stop the driver, as before.
+static int usb_reap(transport_t* transport) {
+    usb_transport_t* ut = (usb_transport_t*)transport;
+    int fatal = 0;
+
+    for (int i = ut->usb_count - 1; i >= 0; i--) {
+        int err = usb_keypad_error(&ut->usb[i]);
+        if (err != 0) {
+            stop_usb_keypad(ut, i, err);
+            if (err != LIBUSB_ERROR_NO_DEVICE) {
+                fatal = 1;
+            }
+        }
+    }
+    transport->keypads = ut->usb_count;
+    return fatal ? -1 : 0;
+}
+
+// libusb timeouts are normally covered by its own timerfd pollfd
+static int usb_next_timeout(transport_t* transport) {
+    usb_transport_t* ut = (usb_transport_t*)transport;
+    struct timeval tv;
+
+    if (libusb_pollfds_handle_timeouts(ut->ctx) || libusb_get_next_timeout(ut->ctx, &tv) != 1) {
+        return -1;
+    }
+    return (int)(tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000);
+}
+
+static void usb_after_wait(transport_t* transport) {
+    usb_transport_t* ut = (usb_transport_t*)transport;
+
+    if (!libusb_pollfds_handle_timeouts(ut->ctx)) {
+        struct timeval zero = {0, 0};
+        libusb_handle_events_timeout_completed(ut->ctx, &zero, NULL);
+    }
+}
+
+static void usb_destroy(transport_t* transport) {
+    usb_transport_t* ut = (usb_transport_t*)transport;
+
+    // Release whatever is still attached
+    while (ut->usb_count > 0) {
+        stop_usb_keypad(ut, ut->usb_count - 1, 0);
+    }
+    if (transport->hotplug) {
+        libusb_hotplug_deregister_callback(ut->ctx, ut->hotplug_handle);
+    }
+    libusb_set_pollfd_notifiers(ut->ctx, NULL, NULL, NULL);
+    free(ut);
+}
+
+static const transport_ops_t usb_transport_ops = {
+    "libusb",
+    usb_scan,
+    usb_reap,
+    usb_next_timeout,
+    usb_after_wait,
+    usb_destroy
+};
+
+transport_t* usb_transport_create(libusb_context* ctx, config_t* config, dispatcher_t* dispatcher,
+                                  reactor_t* reactor, int debug, int accept) {
+    usb_transport_t* ut = calloc(1, sizeof(usb_transport_t));
+    if (ut == NULL) return NULL;
+
+    ut->base.ops = &usb_transport_ops;
+    ut->base.dispatcher = dispatcher;
+    ut->base.reactor = reactor;
+    ut->base.debug = debug;
+    ut->ctx = ctx;
+    ut->config = config;
+    ut->accept = accept;
+
+    // Completed transfers are reaped when a libusb pollfd becomes readable
+    const struct libusb_pollfd** pollfds = libusb_get_pollfds(ctx);
+    if (pollfds) {
+        for (int i = 0; pollfds[i] != NULL; i++) {
+            on_usb_pollfd_added(pollfds[i]->fd, pollfds[i]->events, ut);
+        }
+        libusb_free_pollfds(pollfds);
+    }
+    libusb_set_pollfd_notifiers(ctx, on_usb_pollfd_added, on_usb_pollfd_removed, ut);
+
+    // Event-driven attach/detach when libusb supports it
+    if (config->hotplug && libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        int hp_err = libusb_hotplug_register_callback(ctx,
+            LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+            0, DEVICE_VID, DEVICE_PID, LIBUSB_HOTPLUG_MATCH_ANY,
+            on_hotplug, ut, &ut->hotplug_handle);
+        if (hp_err == LIBUSB_SUCCESS) {
+            ut->base.hotplug = 1;
+        } else {
+            printf("Hotplug: registration failed (%s), polling for devices\n",
+                   libusb_error_name(hp_err));
+        }
+    } else if (config->hotplug && debug) {
+        printf("Hotplug: not supported on this platform, polling for devices\n");
+    }
+
+    return &ut->base;
+}
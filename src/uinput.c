@@ -0,0 +1,275 @@
+#include "uinput.h"
+#include "action.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <linux/uinput.h>
+
+#define EVENT_BATCH     256
+
+// Virtual device ID. Not the keypad's: udev/hwdb rules, libinput tablet
+// quirks and the driver's own device scans must not take it for one.
+#define UINPUT_VENDOR   0x0000
+#define UINPUT_PRODUCT  0x4b44   // "KD"
+
+// Keysym name -> key code (US layout). Letters and digits are handled
+// separately.
+static const struct {
+    const char* name;
+    unsigned short code;
+    int shift;
+} KEYMAP[] = {
+    // Modifiers (xdotool aliases first)
+    {"ctrl", KEY_LEFTCTRL, 0}, {"control", KEY_LEFTCTRL, 0},
+    {"Control_L", KEY_LEFTCTRL, 0}, {"Control_R", KEY_RIGHTCTRL, 0},
+    {"shift", KEY_LEFTSHIFT, 0}, {"Shift_L", KEY_LEFTSHIFT, 0}, {"Shift_R", KEY_RIGHTSHIFT, 0},
+    {"alt", KEY_LEFTALT, 0}, {"Alt_L", KEY_LEFTALT, 0}, {"Alt_R", KEY_RIGHTALT, 0},
+    {"ISO_Level3_Shift", KEY_RIGHTALT, 0},
+    {"super", KEY_LEFTMETA, 0}, {"Super_L", KEY_LEFTMETA, 0}, {"Super_R", KEY_RIGHTMETA, 0},
+    {"meta", KEY_LEFTMETA, 0}, {"Meta_L", KEY_LEFTMETA, 0}, {"Meta_R", KEY_RIGHTMETA, 0},
+
+    // Editing and navigation
+    {"Return", KEY_ENTER, 0}, {"enter", KEY_ENTER, 0}, {"KP_Enter", KEY_KPENTER, 0},
+    {"Escape", KEY_ESC, 0}, {"Tab", KEY_TAB, 0}, {"BackSpace", KEY_BACKSPACE, 0},
+    {"space", KEY_SPACE, 0}, {"Delete", KEY_DELETE, 0}, {"Insert", KEY_INSERT, 0},
+    {"Home", KEY_HOME, 0}, {"End", KEY_END, 0},
+    {"Page_Up", KEY_PAGEUP, 0}, {"Prior", KEY_PAGEUP, 0},
+    {"Page_Down", KEY_PAGEDOWN, 0}, {"Next", KEY_PAGEDOWN, 0},
+    {"Left", KEY_LEFT, 0}, {"Right", KEY_RIGHT, 0}, {"Up", KEY_UP, 0}, {"Down", KEY_DOWN, 0},
+    {"Caps_Lock", KEY_CAPSLOCK, 0}, {"Num_Lock", KEY_NUMLOCK, 0}, {"Scroll_Lock", KEY_SCROLLLOCK, 0},
+    {"Print", KEY_SYSRQ, 0}, {"Pause", KEY_PAUSE, 0}, {"Menu", KEY_COMPOSE, 0},
+
+    // Punctuation
+    {"minus", KEY_MINUS, 0}, {"underscore", KEY_MINUS, 1},
+    {"equal", KEY_EQUAL, 0}, {"plus", KEY_EQUAL, 1},
+    {"bracketleft", KEY_LEFTBRACE, 0}, {"braceleft", KEY_LEFTBRACE, 1},
+    {"bracketright", KEY_RIGHTBRACE, 0}, {"braceright", KEY_RIGHTBRACE, 1},
+    {"backslash", KEY_BACKSLASH, 0}, {"bar", KEY_BACKSLASH, 1},
+    {"semicolon", KEY_SEMICOLON, 0}, {"colon", KEY_SEMICOLON, 1},
+    {"apostrophe", KEY_APOSTROPHE, 0}, {"quotedbl", KEY_APOSTROPHE, 1},
+    {"grave", KEY_GRAVE, 0}, {"asciitilde", KEY_GRAVE, 1},
+    {"comma", KEY_COMMA, 0}, {"less", KEY_COMMA, 1},
+    {"period", KEY_DOT, 0}, {"greater", KEY_DOT, 1},
+    {"slash", KEY_SLASH, 0}, {"question", KEY_SLASH, 1},
+    {"exclam", KEY_1, 1}, {"at", KEY_2, 1}, {"numbersign", KEY_3, 1}, {"dollar", KEY_4, 1},
+    {"percent", KEY_5, 1}, {"asciicircum", KEY_6, 1}, {"ampersand", KEY_7, 1},
+    {"asterisk", KEY_8, 1}, {"parenleft", KEY_9, 1}, {"parenright", KEY_0, 1},
+
+    // Keypad
+    {"KP_0", KEY_KP0, 0}, {"KP_1", KEY_KP1, 0}, {"KP_2", KEY_KP2, 0}, {"KP_3", KEY_KP3, 0},
+    {"KP_4", KEY_KP4, 0}, {"KP_5", KEY_KP5, 0}, {"KP_6", KEY_KP6, 0}, {"KP_7", KEY_KP7, 0},
+    {"KP_8", KEY_KP8, 0}, {"KP_9", KEY_KP9, 0},
+    {"KP_Add", KEY_KPPLUS, 0}, {"KP_Subtract", KEY_KPMINUS, 0},
+    {"KP_Multiply", KEY_KPASTERISK, 0}, {"KP_Divide", KEY_KPSLASH, 0}, {"KP_Decimal", KEY_KPDOT, 0},
+
+    // Media
+    {"XF86AudioRaiseVolume", KEY_VOLUMEUP, 0}, {"XF86AudioLowerVolume", KEY_VOLUMEDOWN, 0},
+    {"XF86AudioMute", KEY_MUTE, 0}, {"XF86AudioPlay", KEY_PLAYPAUSE, 0},
+    {"XF86AudioNext", KEY_NEXTSONG, 0}, {"XF86AudioPrev", KEY_PREVIOUSSONG, 0},
+};
+
+static const unsigned short LETTER_KEYS[26] = {
+    KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+    KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+};
+
+static const unsigned short DIGIT_KEYS[10] = {
+    KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9
+};
+
+static const unsigned short FUNCTION_KEYS[24] = {
+    KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12,
+    KEY_F13, KEY_F14, KEY_F15, KEY_F16, KEY_F17, KEY_F18, KEY_F19, KEY_F20, KEY_F21, KEY_F22, KEY_F23, KEY_F24
+};
+
+// Mouse buttons 1-3 (4 and 5 are wheel steps)
+static const unsigned short MOUSE_BUTTONS[3] = {BTN_LEFT, BTN_MIDDLE, BTN_RIGHT};
+
+static int uinput_fd = -1;
+static int uinput_debug = 0;
+
+int uinput_lookup(const char* name, unsigned short* code, int* shift) {
+    size_t len = strlen(name);
+
+    *shift = 0;
+    if (len == 1 && name[0] >= 'a' && name[0] <= 'z') {
+        *code = LETTER_KEYS[name[0] - 'a'];
+        return 0;
+    }
+    if (len == 1 && name[0] >= 'A' && name[0] <= 'Z') {
+        *code = LETTER_KEYS[name[0] - 'A'];
+        *shift = 1;
+        return 0;
+    }
+    if (len == 1 && name[0] >= '0' && name[0] <= '9') {
+        *code = DIGIT_KEYS[name[0] - '0'];
+        return 0;
+    }
+    if ((name[0] == 'F' || name[0] == 'f') && len >= 2 && len <= 3) {
+        int n = 0;
+        for (size_t i = 1; i < len; i++) {
+            if (name[i] < '0' || name[i] > '9') { n = 0; break; }
+            n = n * 10 + (name[i] - '0');
+        }
+        if (n >= 1 && n <= 24) {
+            *code = FUNCTION_KEYS[n - 1];
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < sizeof(KEYMAP) / sizeof(KEYMAP[0]); i++) {
+        if (strcasecmp(name, KEYMAP[i].name) == 0) {
+            *code = KEYMAP[i].code;
+            *shift = KEYMAP[i].shift;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// ============================================================================
+// Event batches
+// ============================================================================
+
+typedef struct {
+    struct input_event events[EVENT_BATCH];
+    int count;
+} batch_t;
+
+static int batch_flush(batch_t* batch) {
+    size_t size = batch->count * sizeof(struct input_event);
+    batch->count = 0;
+    if (size == 0) return 0;
+
+    ssize_t written = write(uinput_fd, batch->events, size);
+    if (written != (ssize_t)size) {
+        if (uinput_debug == 1) printf("uinput: write failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void batch_add(batch_t* batch, unsigned short type, unsigned short code, int value) {
+    // Keep room for the SYN_REPORT that closes a group
+    if (batch->count >= EVENT_BATCH - 1 && type != EV_SYN) {
+        batch_flush(batch);
+    }
+    struct input_event* ev = &batch->events[batch->count++];
+    memset(ev, 0, sizeof(*ev));
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+}
+
+static void batch_sync(batch_t* batch) {
+    batch_add(batch, EV_SYN, SYN_REPORT, 0);
+}
+
+// ============================================================================
+// Device
+// ============================================================================
+
+int uinput_open(int debug) {
+    struct uinput_setup setup;
+
+    uinput_debug = debug;
+    if (uinput_fd >= 0) return 0;
+
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        printf("uinput: Cannot open /dev/uinput: %s\n", strerror(errno));
+        return -1;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_SYN);
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd, UI_SET_EVBIT, EV_REL);
+
+    // Every key the keymap can produce, plus the mouse
+    for (int code = KEY_ESC; code <= KEY_MICMUTE; code++) {
+        ioctl(fd, UI_SET_KEYBIT, code);
+    }
+    for (int i = 0; i < 3; i++) {
+        ioctl(fd, UI_SET_KEYBIT, MOUSE_BUTTONS[i]);
+    }
+    ioctl(fd, UI_SET_RELBIT, REL_X);
+    ioctl(fd, UI_SET_RELBIT, REL_Y);
+    ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = UINPUT_VENDOR;
+    setup.id.product = UINPUT_PRODUCT;
+    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "KD100 virtual input");
+
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        printf("uinput: Cannot create virtual device: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    uinput_fd = fd;
+    if (debug) {
+        printf("uinput: Created virtual keyboard/mouse\n");
+    }
+    return 0;
+}
+
+void uinput_close(void) {
+    if (uinput_fd >= 0) {
+        ioctl(uinput_fd, UI_DEV_DESTROY);
+        close(uinput_fd);
+        uinput_fd = -1;
+    }
+}
+
+int uinput_action(const action_t* action, int type, int count) {
+    batch_t batch;
+    int op_count;
+
+    if (uinput_fd < 0 || !(action->flags & ACTION_HAS_CODES)) return -1;
+
+    const action_op_t* ops = action_sequence(action, type, &op_count);
+    batch.count = 0;
+    if (count < 1) count = 1;
+    for (int n = 0; n < (type == -1 ? count : 1); n++) {
+        for (int i = 0; i < op_count; i++) {
+            const action_key_t* key = &action->keys[ops[i].key];
+            switch (ops[i].op) {
+                case ACTION_OP_PRESS:
+                    if (key->shift) batch_add(&batch, EV_KEY, KEY_LEFTSHIFT, 1);
+                    batch_add(&batch, EV_KEY, key->code, 1);
+                    break;
+                case ACTION_OP_RELEASE:
+                    batch_add(&batch, EV_KEY, key->code, 0);
+                    if (key->shift) batch_add(&batch, EV_KEY, KEY_LEFTSHIFT, 0);
+                    break;
+                default:
+                    batch_sync(&batch);
+                    break;
+            }
+        }
+    }
+    return batch_flush(&batch);
+}
+
+int uinput_button(int button, int press) {
+    batch_t batch;
+
+    if (uinput_fd < 0 || button < 1 || button > 5) return -1;
+
+    batch.count = 0;
+    if (button <= 3) {
+        batch_add(&batch, EV_KEY, MOUSE_BUTTONS[button - 1], press ? 1 : 0);
+    } else if (press) {
+        batch_add(&batch, EV_REL, REL_WHEEL, button == 4 ? 1 : -1);
+    } else {
+        return 0;
+    }
+    batch_sync(&batch);
+    return batch_flush(&batch);
+}
@@ -0,0 +1,37 @@
+#ifndef UINPUT_H
+#define UINPUT_H
+
+#include "action.h"
+
+// ============================================================================
+// UINPUT INJECTION
+// ============================================================================
+//
+// Creates a virtual keyboard + mouse through /dev/uinput once at startup.
+// Each action is encoded as a batch of input_events (with SYN_REPORT after
+// every press and release) and sent with a single write(), so it works on
+// X11, Wayland and the console.
+//
+// Keysym names are mapped to Linux key codes for a US layout when actions
+// are compiled (see action.h); characters on the shifted level ("A",
+// "plus", "question", ...) are sent with Shift held. Mouse buttons 4 and 5
+// scroll the wheel, as they do in X.
+//
+// ============================================================================
+
+// Create the virtual device. Returns -1 if /dev/uinput can't be used.
+int uinput_open(int debug);
+void uinput_close(void);
+
+// Key code of a keysym name; shift is set for shifted characters.
+// Returns -1 if the name isn't in the keymap. Needs no device.
+int uinput_lookup(const char* name, unsigned short* code, int* shift);
+
+// type: -1 = full press, 0 = key down, 1 = key up. A full press is sent
+// count times. Returns -1 if a key isn't in the keymap (nothing is sent).
+int uinput_action(const action_t* action, int type, int count);
+
+// Press or release mouse button 1-5
+int uinput_button(int button, int press);
+
+#endif // UINPUT_H
@@ -3,23 +3,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <sys/time.h>
+#include <time.h>
 
-// External keycode array (defined in main)
-extern int keycodes[];
+// Virtual deadline clock (-1 = CLOCK_MONOTONIC)
+static long virtual_time_ms = -1;
 
-// Get current time in milliseconds
+// Current CLOCK_MONOTONIC time in milliseconds (for deadlines: unlike the
+// wall clock it never jumps)
 long get_time_ms(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+    if (virtual_time_ms >= 0) return virtual_time_ms;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+// Same clock in nanoseconds (timestamps and durations)
+uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 }
 
-// Calculate time difference in milliseconds
-long time_diff_ms(struct timeval start, struct timeval end) {
-    long sec_diff = end.tv_sec - start.tv_sec;
-    long usec_diff = end.tv_usec - start.tv_usec;
-    return (sec_diff * 1000) + (usec_diff / 1000);
+// Run get_time_ms(), and so every deadline and timer, on a clock set from
+// outside: a fast replay steps it through the recorded timestamps so
+// timers fire and windows close as they did in the recorded run.
+// get_time_ns() stays on CLOCK_MONOTONIC for latency and throughput.
+void set_virtual_time_ms(long ms) {
+    virtual_time_ms = ms;
 }
 
 // Trim trailing spaces from a string
@@ -58,14 +69,50 @@ const char* leader_mode_to_string(leader_mode_t mode) {
     }
 }
 
-// Find button index from keycode
-int find_button_index(int keycode) {
-    for (int k = 0; k < 19; k++) {  // Only 0-17 for buttons, 18 is wheel button
-        if (keycodes[k] == keycode) {
-            return k;
-        }
+// Parse hold mode from string
+hold_mode_t parse_hold_mode(const char* mode_str) {
+    if (mode_str == NULL) return HOLD_MODE_TAP;
+
+    if (strcasecmp(mode_str, "hold") == 0) {
+        return HOLD_MODE_HOLD;
+    } else if (strcasecmp(mode_str, "repeat") == 0) {
+        return HOLD_MODE_REPEAT;
+    }
+
+    return HOLD_MODE_TAP; // Default
+}
+
+// Convert hold mode to string
+const char* hold_mode_to_string(hold_mode_t mode) {
+    switch (mode) {
+        case HOLD_MODE_TAP: return "tap";
+        case HOLD_MODE_HOLD: return "hold";
+        case HOLD_MODE_REPEAT: return "repeat";
+        default: return "unknown";
+    }
+}
+
+// Parse tap-hold mode from string
+tap_hold_mode_t parse_tap_hold_mode(const char* mode_str) {
+    if (mode_str == NULL) return TAP_HOLD_TIMEOUT;
+
+    if (strcasecmp(mode_str, "permissive") == 0) {
+        return TAP_HOLD_PERMISSIVE;
+    } else if (strcasecmp(mode_str, "interrupt") == 0) {
+        return TAP_HOLD_INTERRUPT;
+    }
+
+    return TAP_HOLD_TIMEOUT; // Default
+}
+
+// Convert tap-hold mode to string
+const char* tap_hold_mode_to_string(tap_hold_mode_t mode) {
+    switch (mode) {
+        case TAP_HOLD_TIMEOUT: return "timeout";
+        case TAP_HOLD_PERMISSIVE: return "permissive";
+        case TAP_HOLD_INTERRUPT: return "interrupt";
+        default: return "unknown";
     }
-    return -1;
 }
 
 // Check if a key is a modifier
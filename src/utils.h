@@ -1,7 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-#include <sys/time.h>
+#include <stdint.h>
 
 // Leader mode enumeration
 typedef enum {
@@ -10,9 +10,24 @@ typedef enum {
     LEADER_MODE_TOGGLE       // Leader toggles on/off (press to enable, press again to disable)
 } leader_mode_t;
 
+// What a type 0 key does while its button is held
+typedef enum {
+    HOLD_MODE_TAP,           // One press on button down (default)
+    HOLD_MODE_HOLD,          // Key down while the button is held, key up on release
+    HOLD_MODE_REPEAT         // Press, then autorepeat while the button is held
+} hold_mode_t;
+
+// What another button pressed during a tap-hold decision does
+typedef enum {
+    TAP_HOLD_TIMEOUT,        // Nothing: only the hold threshold decides (default)
+    TAP_HOLD_PERMISSIVE,     // Pressed and released while held: hold
+    TAP_HOLD_INTERRUPT       // Pressed while held: hold
+} tap_hold_mode_t;
+
 // Time utilities
-long get_time_ms(void);
-long time_diff_ms(struct timeval start, struct timeval end);
+long get_time_ms(void);         // CLOCK_MONOTONIC, or the virtual clock
+uint64_t get_time_ns(void);     // CLOCK_MONOTONIC
+void set_virtual_time_ms(long ms);  // Deadlines on recorded time (-1 = off)
 
 // String utilities
 void trim_trailing_spaces(char* str);
@@ -22,8 +37,15 @@ char* Substring(const char* in, int start, int end);
 leader_mode_t parse_leader_mode(const char* mode_str);
 const char* leader_mode_to_string(leader_mode_t mode);
 
+// Hold mode utilities
+hold_mode_t parse_hold_mode(const char* mode_str);
+const char* hold_mode_to_string(hold_mode_t mode);
+
+// Tap-hold mode utilities
+tap_hold_mode_t parse_tap_hold_mode(const char* mode_str);
+const char* tap_hold_mode_to_string(tap_hold_mode_t mode);
+
 // Button utilities
-int find_button_index(int keycode);
 int is_modifier_key(const char* key);
 
 #endif // UTILS_H
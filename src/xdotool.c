@@ -0,0 +1,308 @@
+#include "xdotool.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+
+// Minimum time between two restarts of a coprocess that keeps dying
+#define RESTART_INTERVAL_MS 250
+
+// Time the coprocess gets to finish its commands at shutdown
+#define EXIT_TIMEOUT_MS 1000
+
+// xdotool's script mode ("xdotool -") reads its input to EOF before it runs
+// anything, so the coprocess is a shell that runs xdotool for every line as
+// it arrives. Arguments are split on blanks, never globbed.
+#define READER_SCRIPT "set -f; while IFS= read -r line; do xdotool $line </dev/null; done"
+
+static pid_t coproc_pid = -1;
+static int coproc_fd = -1;
+static int coproc_debug = 0;
+static int coproc_enabled = 0;          // xdotool_open() succeeded once
+static long last_restart_ms = 0;
+
+static char queue[XDOTOOL_QUEUE_SIZE];
+static size_t queued = 0;
+static size_t dropped = 0;
+static int overflowing = 0;             // Dropping until the queue drains
+static int mid_line = 0;                // queue[0] continues a partly written line
+
+static reactor_t* coproc_reactor = NULL;
+static reactor_source_t* coproc_source = NULL;
+
+// Fork the reader with its stdin on a pipe. Exec failures are reported
+// back over a close-on-exec status pipe.
+static int spawn(void) {
+    int cmd_pipe[2], status_pipe[2];
+
+    if (pipe(cmd_pipe) < 0) return -1;
+    if (pipe(status_pipe) < 0) {
+        close(cmd_pipe[0]);
+        close(cmd_pipe[1]);
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(cmd_pipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(status_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Signals the driver ignores or handles via signalfd must work normally
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        signal(SIGPIPE, SIG_DFL);
+
+        dup2(cmd_pipe[0], STDIN_FILENO);
+        execl("/bin/sh", "sh", "-c", READER_SCRIPT, (char*)NULL);
+        int err = errno;
+        if (write(status_pipe[1], &err, sizeof(err)) < 0) {
+            // Nothing left to report to
+        }
+        _exit(127);
+    }
+
+    close(cmd_pipe[0]);
+    close(status_pipe[1]);
+    if (pid < 0) {
+        close(cmd_pipe[1]);
+        close(status_pipe[0]);
+        return -1;
+    }
+
+    int err = 0;
+    ssize_t n;
+    while ((n = read(status_pipe[0], &err, sizeof(err))) < 0 && errno == EINTR) {
+    }
+    close(status_pipe[0]);
+    if (n > 0) {
+        waitpid(pid, NULL, 0);
+        close(cmd_pipe[1]);
+        if (coproc_debug) printf("xdotool: Cannot run /bin/sh: %s\n", strerror(err));
+        return -1;
+    }
+
+    fcntl(cmd_pipe[1], F_SETFL, fcntl(cmd_pipe[1], F_GETFL) | O_NONBLOCK);
+    coproc_pid = pid;
+    coproc_fd = cmd_pipe[1];
+    last_restart_ms = get_time_ms();
+    if (coproc_debug) printf("xdotool: Coprocess started (pid %d)\n", (int)pid);
+    return 0;
+}
+
+static void watch_writable(int enable);
+
+// Forget a dead coprocess. A line it only got part of is discarded, so the
+// next coprocess doesn't start mid-command.
+static void reap(void) {
+    watch_writable(0);
+    if (coproc_fd >= 0) {
+        close(coproc_fd);
+        coproc_fd = -1;
+    }
+    if (coproc_pid > 0) {
+        waitpid(coproc_pid, NULL, 0);
+        coproc_pid = -1;
+    }
+    if (mid_line) {
+        char* newline = memchr(queue, '\n', queued);
+        size_t skip = newline ? (size_t)(newline - queue) + 1 : queued;
+        memmove(queue, queue + skip, queued - skip);
+        queued -= skip;
+        mid_line = 0;
+    }
+    if (coproc_debug) printf("xdotool: Coprocess exited\n");
+}
+
+// Write as much of the queue as the pipe takes. Returns -1 if the
+// coprocess is gone.
+static int flush_queue(void) {
+    while (queued > 0) {
+        ssize_t n = write(coproc_fd, queue, queued);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            reap();
+            return -1;
+        }
+        if (n == 0) break;
+        mid_line = (size_t)n < queued && queue[n - 1] != '\n';
+        memmove(queue, queue + n, queued - n);
+        queued -= n;
+    }
+    if (queued == 0) overflowing = 0;
+    watch_writable(queued > 0);
+    return 0;
+}
+
+// Send queued commands, restarting the coprocess if it has died
+static void drain(void) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (coproc_fd < 0) {
+            if (get_time_ms() - last_restart_ms < RESTART_INTERVAL_MS) return;
+            if (spawn() < 0) {
+                last_restart_ms = get_time_ms();
+                return;
+            }
+        }
+        if (flush_queue() == 0) return;
+    }
+}
+
+static void on_writable(int fd, unsigned int events, void* user_data) {
+    (void)fd;
+    (void)user_data;
+
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        reap();
+    }
+    drain();
+}
+
+// Only watched while commands are queued: an idle pipe is always writable
+static void watch_writable(int enable) {
+    if (enable && coproc_source == NULL && coproc_reactor && coproc_fd >= 0) {
+        coproc_source = reactor_add_fd(coproc_reactor, coproc_fd, EPOLLOUT, on_writable, NULL);
+    } else if (!enable && coproc_source) {
+        reactor_remove_fd(coproc_reactor, coproc_source);
+        coproc_source = NULL;
+    }
+}
+
+// xdotool is on the PATH (the reader only finds out line by line)
+static int xdotool_found(void) {
+    const char* path = getenv("PATH");
+    if (path == NULL) return 0;
+
+    while (*path) {
+        size_t len = strcspn(path, ":");
+        char file[1024];
+        if (len > 0 && len < sizeof(file) - 9) {
+            snprintf(file, sizeof(file), "%.*s/xdotool", (int)len, path);
+            if (access(file, X_OK) == 0) return 1;
+        }
+        path += len;
+        if (*path == ':') path++;
+    }
+    return 0;
+}
+
+int xdotool_open(int debug) {
+    coproc_debug = debug;
+    if (coproc_fd >= 0) return 0;
+
+    if (!xdotool_found()) {
+        if (debug) printf("xdotool: xdotool not found on the PATH\n");
+        return -1;
+    }
+
+    // A dead coprocess must show up as EPIPE, not kill the driver
+    signal(SIGPIPE, SIG_IGN);
+    if (spawn() < 0) {
+        return -1;
+    }
+    coproc_enabled = 1;
+    return 0;
+}
+
+void xdotool_close(void) {
+    watch_writable(0);
+    if (coproc_fd >= 0) {
+        flush_queue();
+        for (size_t i = 0; i < queued; i++) {
+            if (queue[i] == '\n') dropped++;
+        }
+        close(coproc_fd);
+        coproc_fd = -1;
+    }
+    if (coproc_pid > 0) {
+        // EOF lets the coprocess finish what it has been sent; a stuck one
+        // is terminated
+        long deadline = get_time_ms() + EXIT_TIMEOUT_MS;
+        while (waitpid(coproc_pid, NULL, WNOHANG) == 0) {
+            if (get_time_ms() >= deadline) {
+                kill(coproc_pid, SIGTERM);
+                waitpid(coproc_pid, NULL, 0);
+                break;
+            }
+            usleep(10000);
+        }
+        coproc_pid = -1;
+    }
+    if (dropped > 0) {
+        printf("xdotool: %zu command(s) not delivered\n", dropped);
+    }
+    queued = 0;
+    dropped = 0;
+    overflowing = 0;
+    mid_line = 0;
+    coproc_enabled = 0;
+}
+
+int xdotool_running(void) {
+    return coproc_enabled;
+}
+
+// Key and mouse button releases: never dropped, or the key stays down
+static int is_release(const char* line) {
+    return strncmp(line, "keyup ", 6) == 0 || strncmp(line, "mouseup ", 8) == 0;
+}
+
+// Drop queued commands other than releases until needed more bytes fit.
+// A line already partly written stays. Returns 0 if there is room now.
+static int make_room(size_t needed) {
+    size_t read_pos = 0, write_pos = 0;
+
+    if (mid_line) {
+        char* newline = memchr(queue, '\n', queued);
+        read_pos = write_pos = newline ? (size_t)(newline - queue) + 1 : queued;
+    }
+    while (read_pos < queued) {
+        char* newline = memchr(queue + read_pos, '\n', queued - read_pos);
+        size_t line_len = (newline ? (size_t)(newline - queue) + 1 : queued) - read_pos;
+        int keep = is_release(queue + read_pos) ||
+                   queued - (read_pos - write_pos) + needed <= sizeof(queue);
+        if (keep) {
+            memmove(queue + write_pos, queue + read_pos, line_len);
+            write_pos += line_len;
+        } else {
+            dropped++;
+        }
+        read_pos += line_len;
+    }
+    queued = write_pos;
+    return queued + needed <= sizeof(queue) ? 0 : -1;
+}
+
+int xdotool_send(const char* command) {
+    if (!coproc_enabled) return -1;
+
+    size_t len = strlen(command);
+    if (queued + len + 1 > sizeof(queue) &&
+        (!is_release(command) || make_room(len + 1) < 0)) {
+        if (coproc_debug && !overflowing) printf("xdotool: Queue full, dropping commands\n");
+        overflowing = 1;
+        dropped++;
+        return -1;
+    }
+    memcpy(queue + queued, command, len);
+    queue[queued + len] = '\n';
+    queued += len + 1;
+
+    drain();
+    return 0;
+}
+
+void xdotool_attach_reactor(reactor_t* reactor) {
+    watch_writable(0);
+    coproc_reactor = reactor;
+    watch_writable(queued > 0);
+}
@@ -0,0 +1,41 @@
+#ifndef XDOTOOL_H
+#define XDOTOOL_H
+
+#include "reactor.h"
+
+// ============================================================================
+// XDOTOOL COPROCESS
+// ============================================================================
+//
+// Keeps one reader process running and streams commands to its stdin,
+// one per line ("key ctrl+c", "mousedown 1", ...). The reader is a shell
+// that runs xdotool for each line as it arrives, in order, so the driver
+// never forks or waits for xdotool itself. xdotool semantics (keysym
+// remapping, layouts) are unchanged. (xdotool's own script mode, "xdotool
+// -", reads to EOF before it runs anything and can't be streamed to.)
+//
+// The pipe is non-blocking. Commands that don't fit are kept in a bounded
+// queue, drained when the pipe becomes writable (once a reactor is
+// attached) or before the next command; when the queue is full the command
+// is dropped. Key and button releases are never dropped: queued commands
+// that aren't releases make room for them. If the coprocess dies it is
+// restarted on the next command.
+//
+// ============================================================================
+
+// Bytes of commands kept while the pipe is full
+#define XDOTOOL_QUEUE_SIZE 16384
+
+// Start the coprocess. Returns -1 if xdotool or /bin/sh can't be run.
+int xdotool_open(int debug);
+void xdotool_close(void);
+int xdotool_running(void);
+
+// Send one command (without the "xdotool" prefix or newline).
+// Returns 0 when sent or queued, -1 when dropped.
+int xdotool_send(const char* command);
+
+// Drain the queue from this reactor when the pipe is writable (NULL = detach)
+void xdotool_attach_reactor(reactor_t* reactor);
+
+#endif // XDOTOOL_H
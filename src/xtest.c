@@ -0,0 +1,193 @@
+#include "xtest.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+static Display* display = NULL;
+static KeyCode shift_keycode = 0;
+static int xtest_debug = 0;
+
+// Connection watched for MappingNotify
+static reactor_t* xtest_reactor = NULL;
+static reactor_source_t* display_source = NULL;
+
+// Open batch: flushing is held back until the outermost end
+static int batch_depth = 0;
+static unsigned long batch_first_request;  // XNextRequest() when it opened
+static unsigned long batch_last_known;     // LastKnownRequestProcessed() then
+
+static struct {
+    long flushes;
+    long requests;
+    long round_trips;
+} stats;
+
+int xtest_open(int debug) {
+    int event_base, error_base, major, minor;
+
+    xtest_debug = debug;
+    if (display) return 0;
+
+    display = XOpenDisplay(NULL);
+    if (display == NULL) {
+        printf("XTest: Cannot open X display\n");
+        return -1;
+    }
+    if (!XTestQueryExtension(display, &event_base, &error_base, &major, &minor)) {
+        printf("XTest: Extension not available\n");
+        XCloseDisplay(display);
+        display = NULL;
+        return -1;
+    }
+
+    shift_keycode = XKeysymToKeycode(display, XK_Shift_L);
+    if (debug) {
+        printf("XTest: Using XTest %d.%d for key injection\n", major, minor);
+    }
+    return 0;
+}
+
+// Handle the events on the connection: only MappingNotify matters, it is
+// sent to every client. mode: QueuedAlready (no I/O) or QueuedAfterReading
+// (reads without flushing, so an open batch stays queued).
+static void process_events(int mode) {
+    while (XEventsQueued(display, mode) > 0) {
+        XEvent event;
+        XNextEvent(display, &event);
+        if (event.type != MappingNotify || event.xmapping.request == MappingPointer) continue;
+
+        XRefreshKeyboardMapping(&event.xmapping);
+        shift_keycode = XKeysymToKeycode(display, XK_Shift_L);
+        if (xtest_debug) {
+            printf("XTest: Keyboard mapping changed\n");
+        }
+    }
+}
+
+static void on_display_ready(int fd, unsigned int events, void* user_data) {
+    (void)fd;
+    (void)events;
+    (void)user_data;
+    process_events(QueuedAfterReading);
+}
+
+void xtest_attach_reactor(reactor_t* reactor) {
+    if (display_source) {
+        reactor_remove_fd(xtest_reactor, display_source);
+        display_source = NULL;
+    }
+    xtest_reactor = reactor;
+
+    if (reactor && display) {
+        display_source = reactor_add_fd(reactor, ConnectionNumber(display), EPOLLIN,
+                                        on_display_ready, NULL);
+    }
+}
+
+void xtest_close(void) {
+    xtest_attach_reactor(NULL);
+    if (display && xtest_debug && stats.flushes > 0) {
+        printf("XTest: %ld requests in %ld flushes (%.1f per flush), %ld round trips\n",
+               stats.requests, stats.flushes, (double)stats.requests / stats.flushes,
+               stats.round_trips);
+    }
+    memset(&stats, 0, sizeof(stats));
+    batch_depth = 0;
+    if (display) {
+        XCloseDisplay(display);
+        display = NULL;
+    }
+}
+
+void xtest_batch_begin(void) {
+    if (display == NULL) return;
+    if (batch_depth++ == 0) {
+        batch_first_request = XNextRequest(display);
+        batch_last_known = LastKnownRequestProcessed(display);
+    }
+}
+
+// Write out the requests queued since the batch opened
+static void flush_batch(void) {
+    unsigned long requests = XNextRequest(display) - batch_first_request;
+    if (requests == 0) return;
+    XFlush(display);
+
+    // Nothing else is read from this connection, so any reply processed
+    // since the batch opened was waited for
+    int round_trips = LastKnownRequestProcessed(display) != batch_last_known;
+    stats.flushes++;
+    stats.requests += (long)requests;
+    stats.round_trips += round_trips;
+    if (xtest_debug == 2) {
+        printf("XTest: %lu requests, 1 flush, %d round trips\n", requests, round_trips);
+    }
+    batch_first_request = XNextRequest(display);
+    batch_last_known = LastKnownRequestProcessed(display);
+}
+
+void xtest_batch_end(void) {
+    if (display == NULL || batch_depth == 0 || --batch_depth > 0) return;
+    flush_batch();
+}
+
+void xtest_flush(void) {
+    if (display && batch_depth > 0) {
+        flush_batch();
+    }
+}
+
+int xtest_action(const action_t* action, int type, int count) {
+    KeyCode keycodes[ACTION_MAX_KEYS];
+    int shifted[ACTION_MAX_KEYS];
+    int op_count;
+
+    if (display == NULL || !(action->flags & ACTION_HAS_KEYSYMS)) return -1;
+
+    // Keycodes depend on the current keyboard mapping. The lookups use
+    // Xlib's copy of it, refreshed on MappingNotify; a notify Xlib already
+    // read while waiting for a reply doesn't wake the reactor.
+    process_events(QueuedAlready);
+    xtest_batch_begin();
+    for (int k = 0; k < action->key_count; k++) {
+        KeySym keysym = (KeySym)action->keys[k].keysym;
+        keycodes[k] = XKeysymToKeycode(display, keysym);
+        if (keycodes[k] == 0) {
+            if (xtest_debug == 1) printf("XTest: No keycode for '%s'\n", XKeysymToString(keysym));
+            xtest_batch_end();
+            return -1;
+        }
+        shifted[k] = shift_keycode && XkbKeycodeToKeysym(display, keycodes[k], 0, 0) != keysym &&
+                     XkbKeycodeToKeysym(display, keycodes[k], 0, 1) == keysym;
+    }
+
+    const action_op_t* ops = action_sequence(action, type, &op_count);
+    if (count < 1) count = 1;
+    for (int n = 0; n < (type == -1 ? count : 1); n++) {
+        for (int i = 0; i < op_count; i++) {
+            int k = ops[i].key;
+            if (ops[i].op == ACTION_OP_PRESS) {
+                if (shifted[k]) XTestFakeKeyEvent(display, shift_keycode, True, CurrentTime);
+                XTestFakeKeyEvent(display, keycodes[k], True, CurrentTime);
+            } else if (ops[i].op == ACTION_OP_RELEASE) {
+                XTestFakeKeyEvent(display, keycodes[k], False, CurrentTime);
+                if (shifted[k]) XTestFakeKeyEvent(display, shift_keycode, False, CurrentTime);
+            }
+        }
+    }
+    xtest_batch_end();
+    return 0;
+}
+
+int xtest_button(int button, int press) {
+    if (display == NULL || button < 1 || button > 5) return -1;
+
+    xtest_batch_begin();
+    XTestFakeButtonEvent(display, (unsigned int)button, press ? True : False, CurrentTime);
+    xtest_batch_end();
+    return 0;
+}
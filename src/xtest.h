@@ -0,0 +1,49 @@
+#ifndef XTEST_H
+#define XTEST_H
+
+#include "action.h"
+#include "reactor.h"
+
+// ============================================================================
+// XTEST INJECTION
+// ============================================================================
+//
+// Sends key and mouse button events through the XTest extension on one
+// persistent display connection, instead of starting a shell and xdotool
+// for every event. Keys come from compiled actions (see action.h).
+//
+// Every request of an action is queued and written with a single flush.
+// Between xtest_batch_begin() and xtest_batch_end() nothing is flushed, so
+// a macro segment of many actions also goes out in one write. Fake input
+// requests have no reply; a round trip only happens when Xlib has to wait
+// for the server (e.g. to fetch the keyboard mapping), and is counted.
+//
+// Keysyms are looked up in Xlib's copy of the keyboard mapping. The server
+// announces mapping changes (setxkbmap, layout switches) with MappingNotify
+// events, so the connection is watched in the reactor and the copy is
+// refreshed when one is read.
+//
+// ============================================================================
+
+// Open the display connection. Returns -1 if X or XTest is unavailable.
+int xtest_open(int debug);
+void xtest_close(void);
+
+// Watch the connection for keyboard mapping changes (NULL = stop)
+void xtest_attach_reactor(reactor_t* reactor);
+
+// type: -1 = full press, 0 = key down, 1 = key up. A full press is sent
+// count times. Returns -1 if a keysym has no keycode (nothing is sent).
+int xtest_action(const action_t* action, int type, int count);
+
+// Press or release mouse button 1-5
+int xtest_button(int button, int press);
+
+// Hold back flushes until the matching xtest_batch_end() (nestable)
+void xtest_batch_begin(void);
+void xtest_batch_end(void);
+
+// Write out an open batch now (before events sent some other way)
+void xtest_flush(void);
+
+#endif // XTEST_H
@@ -0,0 +1,312 @@
+#!/bin/sh
+# Replay-driven checks of the button state machines (make test).
+#
+# Each check writes a capture from a list of timed events, replays it with
+# the counting sink and -d, and compares the number of actions sent and the
+# debug lines that must (or, prefixed with "!", must not) appear.
+#
+# Usage: tests/run.sh [path/to/KD100]
+
+KD100=${1:-$(dirname "$0")/../KD100}
+case $KD100 in
+    /*) ;;
+    *) KD100=$(cd "$(dirname "$KD100")" && pwd)/$(basename "$KD100") ;;
+esac
+cd "$(dirname "$0")" || exit 1
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+PASSED=0
+
+byte() {
+    printf "\\$(printf '%03o' "$1")"
+}
+
+u32() {
+    byte $(($1 & 255)); byte $(($1 >> 8 & 255)); byte $(($1 >> 16 & 255)); byte $(($1 >> 24 & 255))
+}
+
+zeros() {
+    i=0
+    while [ "$i" -lt "$1" ]; do byte 0; i=$((i + 1)); done
+}
+
+# Capture (see src/capture.h) from lines on stdin:
+#   <ms> keys [<button>...]    report with these buttons down
+#   <ms> profile <name>        switch to a profile
+#   <ms> attach <port>         attach the keypad on this USB port
+#   <ms> reload <file>         hot reload a file of the profiles directory
+mkcap() {
+    printf 'KD100CAP'; u32 1; u32 56
+    while read -r ms kind rest; do
+        [ -z "$ms" ] && continue
+        ns=$((ms * 1000000))
+        u32 $((ns & 4294967295)); u32 $((ns >> 32))
+        case $kind in
+            profile) record=1 ;;
+            attach) record=2 ;;
+            reload) record=3 ;;
+            *) record=0 ;;
+        esac
+        if [ $record -ne 0 ]; then
+            byte 0; byte ${#rest}; byte $record; zeros 5
+            printf '%s' "$rest"; zeros $((40 - ${#rest}))
+        else
+            b0=0; b1=0; b2=0
+            for b in $rest; do
+                case $((b / 8)) in
+                    0) b0=$((b0 | 1 << b)) ;;
+                    1) b1=$((b1 | 1 << (b - 8))) ;;
+                    2) b2=$((b2 | 1 << (b - 16))) ;;
+                esac
+            done
+            byte 0; byte 8; byte 0; zeros 5
+            byte 1; zeros 3; byte $b0; byte $b1; byte $b2; zeros 33
+        fi
+    done
+}
+
+# check <name> <config> <actions> [[!]<debug line>...] < events
+# A key press is two actions (key down, key up), a leader combination one.
+# Each capture is replayed twice, fast (on recorded time) and at the
+# recorded pace, and both runs must pass.
+check() {
+    name=$1; config=$2; want=$3
+    shift 3
+    mkcap > "$TMP/$name.cap"
+    errors=""
+
+    for pace in fast paced; do
+        out="$TMP/$name.$pace.out"
+        if [ $pace = fast ]; then
+            "$KD100" -c "$config" --replay "$TMP/$name.cap" --replay-fast --sink count -d > "$out" 2>&1
+        else
+            "$KD100" -c "$config" --replay "$TMP/$name.cap" --sink count -d > "$out" 2>&1
+        fi
+        status=$?
+
+        got=$(sed -n 's/^Actions dispatched: //p' "$out")
+        [ $status -eq 0 ] || errors="$errors\n    $pace: exit status $status"
+        [ "$got" = "$want" ] || errors="$errors\n    $pace: $got actions, expected $want"
+        for line in "$@"; do
+            case $line in
+                !*) grep -qF -- "${line#!}" "$out" && errors="$errors\n    $pace: unexpected: ${line#!}" ;;
+                *) grep -qF -- "$line" "$out" || errors="$errors\n    $pace: missing: $line" ;;
+            esac
+        done
+    done
+
+    if [ -z "$errors" ]; then
+        PASSED=$((PASSED + 1))
+        echo "ok   $name"
+    else
+        FAILED=$((FAILED + 1))
+        echo "FAIL $name"
+        printf "${errors#\\n}\n"
+    fi
+}
+
+# ---------------------------------------------------------------------------
+# Leader sequences (leader.cfg: leader 16, timeout 300, "3 5" and "3 5 7")
+# ---------------------------------------------------------------------------
+
+# "3 5" is also the start of "3 5 7": sent once the timeout passes
+check leader-prefix-timeout leader.cfg 1 \
+    "Leader sequence: 7:ctrl+alt+q" "Sending leader combination: ctrl+shift+p" \
+    "!Sending leader combination: ctrl+alt+q" <<EOF
+0 keys 16
+10 keys
+50 keys 3
+60 keys
+100 keys 5
+110 keys
+EOF
+
+check leader-full-sequence leader.cfg 1 \
+    "Sending leader combination: ctrl+alt+q" "!Sending leader combination: ctrl+shift+p" <<EOF
+0 keys 16
+10 keys
+50 keys 3
+60 keys
+100 keys 5
+110 keys
+150 keys 7
+160 keys
+EOF
+
+# A button that doesn't continue the sequence acts normally
+check leader-broken-sequence leader.cfg 2 \
+    "Button 7 doesn't continue the leader sequence" "!Sending leader combination" <<EOF
+0 keys 16
+10 keys
+50 keys 3
+60 keys
+100 keys 7
+110 keys
+EOF
+
+# A profile switch drops the sequence: its node belongs to the old trie
+check leader-profile-switch leader.cfg 2 \
+    "Replay: switched to profile 'Other'" "!Sending leader combination" <<EOF
+0 keys 16
+10 keys
+50 keys 3
+60 keys
+100 profile Other
+400 keys 5
+410 keys
+EOF
+
+# ---------------------------------------------------------------------------
+# Chords (chord.cfg: "3+5" and "3+5+7", window 100)
+# ---------------------------------------------------------------------------
+
+# "3+5" over two reports, waiting out the window for a "3+5+7"
+check chord-split-reports chord.cfg 1 \
+    "Keypad 0: Button 5 (chord?)" "Keypad 0: Chord ctrl+shift+s" "!Keypad 0: Button 3 released" <<EOF
+0 keys 3
+20 keys 3 5
+300 keys
+EOF
+
+# Nothing longer to wait for: sent at the last button
+check chord-longest chord.cfg 1 \
+    "Keypad 0: Chord ctrl+alt+7" "!Chord ctrl+shift+s" <<EOF
+0 keys 3
+20 keys 3 5
+40 keys 3 5 7
+300 keys
+EOF
+
+# Released inside the window: an ordinary press, just later
+check chord-released-early chord.cfg 2 \
+    "Keypad 0: Button 3 (chord?)" "Keypad 0: Button 3 released" "!Chord" <<EOF
+0 keys 3
+20 keys
+EOF
+
+# A profile switch while the window is open: held back presses become
+# ordinary presses under the new config
+check chord-profile-switch chord.cfg 4 \
+    "Replay: switched to profile 'Other'" "Keypad 0: Button 3 released" "!Chord" <<EOF
+0 keys 3
+20 profile Other
+60 keys 3 5
+300 keys
+EOF
+
+# The capture ends inside the window: it still closes
+check chord-end-of-capture chord.cfg 1 \
+    "Keypad 0: Chord ctrl+shift+s" <<EOF
+0 keys 3
+20 keys 3 5
+EOF
+
+# ---------------------------------------------------------------------------
+# Tap-hold (taphold.cfg: 7 interrupt, 9 permissive, threshold 200)
+# ---------------------------------------------------------------------------
+
+check taphold-tap taphold.cfg 2 \
+    "Keypad 0: Button 7 tapped" "!held" <<EOF
+0 keys 7
+50 keys
+EOF
+
+# The threshold timer decides without waiting for another report
+check taphold-threshold taphold.cfg 2 \
+    "Keypad 0: Button 7 held: ctrl" "!tapped" <<EOF
+0 keys 7
+600 keys
+EOF
+
+# Interrupt: another press decides hold, then the press is passed on
+check taphold-interrupt taphold.cfg 4 \
+    "Keypad 0: Button 7 held: ctrl" "Keypad 0: Button 8" "!tapped" <<EOF
+0 keys 7
+20 keys 7 8
+40 keys 7
+60 keys
+EOF
+
+# Permissive: a press alone doesn't decide, its release does
+check taphold-permissive taphold.cfg 4 \
+    "Keypad 0: Button 9 held: alt" "!tapped" <<EOF
+0 keys 9
+20 keys 9 8
+40 keys 9
+60 keys
+EOF
+
+# Permissive, but released first: a tap, with the other press after it
+check taphold-permissive-tap taphold.cfg 4 \
+    "Keypad 0: Button 9 tapped" "!held" <<EOF
+0 keys 9
+20 keys 9 8
+40 keys 8
+60 keys
+EOF
+
+# The capture ends before the threshold: decided there, released at the end
+check taphold-end-of-capture taphold.cfg 2 \
+    "Keypad 0: Button 7 held: ctrl" <<EOF
+0 keys 7
+EOF
+
+# A profile switch while undecided frees the config of the press; the
+# hold is kept from the press
+check taphold-profile-switch taphold.cfg 2 \
+    "Replay: switched to profile 'Other'" "Keypad 0: Button 7 held: ctrl" <<EOF
+0 profile Other
+20 keys 7
+40 profile Other
+600 keys
+EOF
+
+# ---------------------------------------------------------------------------
+# Hold and autorepeat (hold.cfg: 7 held, 8 repeats after 100 ms every 100 ms)
+# ---------------------------------------------------------------------------
+
+# Down with the button, up with its release, across a profile switch that
+# frees the config of the press
+check hold-profile-switch hold.cfg 2 \
+    "Replay: switched to profile 'Other'" "Keypad 0: Button 7 released" <<EOF
+0 profile Other
+20 keys 7
+40 profile Other
+100 keys
+EOF
+
+# Press, two repeats, release; the profile switch doesn't stop it
+check repeat-profile-switch hold.cfg 6 \
+    "Replay: switched to profile 'Other'" "Keypad 0: Button 8 released" <<EOF
+0 profile Other
+20 keys 8
+150 profile Other
+270 keys
+EOF
+
+# ---------------------------------------------------------------------------
+# Profiles (bound.cfg: the keypad on port 1-1 is bound to profiles.d/other.cfg)
+# ---------------------------------------------------------------------------
+
+# Button 3 does nothing in bound.cfg and types "o" in the bound profile
+check bound-profile bound.cfg 2 \
+    "Keypad 0 (port 1-1) bound to profile 'Other'" <<EOF
+0 attach 1-1
+10 keys 3
+20 keys
+EOF
+
+# A hot reload of the bound profile keeps its overrides
+check bound-profile-reload bound.cfg 4 \
+    "Refreshing configuration for profile other.cfg" <<EOF
+0 attach 1-1
+10 keys 3
+20 keys
+30 reload other.cfg
+40 keys 3
+50 keys
+EOF
+
+echo "$PASSED passed, $FAILED failed"
+[ $FAILED -eq 0 ]